@@ -0,0 +1,201 @@
+// Copyright Avram Cristian - Stefan 2022 stefanavram93@gmail.com
+// Copyright Dumitrescu Rares - Matei 2022 mateidum828@gmail.com
+
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "checkpoint.h"
+#include "export.h"
+#include "undo.h"
+
+#define TMP_SUFFIX ".tmp"
+#define REPORT_PERCENT_STEP 10
+
+typedef struct ProgressState ProgressState;
+
+struct ProgressState {
+    int fd;
+    size_t total;
+    int last_percent;
+    struct timespec start;
+};
+
+static struct {
+    pid_t pid;  // 0 if no checkpoint is running
+    int fd;
+    char* path;
+    int done;
+} running;
+
+static double elapsed_ms(struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e3 +
+           (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static size_t count_nodes(TreeNode *node) {
+    size_t count = 1;
+    FolderContent *directory_content = node->content;
+
+    if (node->type != FOLDER_NODE || !directory_content)
+        return count;
+    for (ListNode *child = directory_content->children->head; child;
+         child = child->next)
+        count += count_nodes(child->info);
+    return count;
+}
+
+static void send_report(int fd, CheckpointReport *report) {
+    while (write(fd, report, sizeof(*report)) < 0 && errno == EINTR)
+        continue;
+}
+
+// A report is sent only when the progress passes the next step
+static void report_progress(const ExportStats *stats, void *arg) {
+    ProgressState *state = arg;
+    size_t nr_of_nodes = stats->nr_of_dir + stats->nr_of_files;
+    int percent = 100 * nr_of_nodes / state->total;
+
+    if (percent < state->last_percent + REPORT_PERCENT_STEP)
+        return;
+    state->last_percent = percent;
+
+    CheckpointReport report = {.type = REPORT_PROGRESS,
+                               .nr_of_nodes = nr_of_nodes,
+                               .total = state->total, .stats = *stats,
+                               .elapsed = elapsed_ms(&state->start)};
+    send_report(state->fd, &report);
+}
+
+/*
+* Runs in the child. The archive is written next to the destination and
+* renamed at the end, so an older checkpoint is replaced only by a
+* complete one.
+*/
+static void write_checkpoint(TreeNode *root, const char *path, int fd) {
+    ProgressState state = {.fd = fd, .last_percent = 0};
+    CheckpointReport report;
+    memset(&report, 0, sizeof(report));
+
+    clock_gettime(CLOCK_MONOTONIC, &state.start);
+    state.total = count_nodes(root);
+    report.total = state.total;
+
+    char *tmp_path = malloc(strlen(path) + strlen(TMP_SUFFIX) + 1);
+    sprintf(tmp_path, "%s%s", path, TMP_SUFFIX);
+
+    int out_fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0 ||
+        write_archive(root, out_fd, report_progress, &state,
+                      &report.stats) < 0 ||
+        fsync(out_fd) < 0 || close(out_fd) < 0 ||
+        rename(tmp_path, path) < 0) {
+        report.type = REPORT_FAILED;
+        report.error = errno;
+        unlink(tmp_path);
+    } else {
+        report.type = REPORT_DONE;
+        report.nr_of_nodes = state.total;
+    }
+    report.elapsed = elapsed_ms(&state.start);
+    send_report(fd, &report);
+}
+
+/*
+* Gives the reports sent by the child since the last call to "result".
+* When the child is gone, a failure is reported (with error 0) if the
+* child did not report the end itself.
+*/
+void checkpoint_poll(int wait, CheckpointResult result, void *arg) {
+    if (!running.pid)
+        return;
+
+    if (wait)
+        fcntl(running.fd, F_SETFL, fcntl(running.fd, F_GETFL) & ~O_NONBLOCK);
+
+    CheckpointReport report;
+    ssize_t bytes;
+    while ((bytes = read(running.fd, &report, sizeof(report))) ==
+           sizeof(report)) {
+        if (report.type != REPORT_PROGRESS)
+            running.done = 1;
+        result(&report, running.path, arg);
+    }
+    if (bytes < 0 && (errno == EAGAIN || errno == EINTR))
+        return;
+
+    // the pipe was closed, so the child is gone (or about to be)
+    int status;
+    waitpid(running.pid, &status, 0);
+    if (!running.done) {
+        memset(&report, 0, sizeof(report));
+        report.type = REPORT_FAILED;
+        result(&report, running.path, arg);
+    }
+    close(running.fd);
+    free(running.path);
+    running.pid = 0;
+}
+
+// The archive that is being written, or NULL
+const char *checkpoint_path(void) {
+    return running.pid ? running.path : NULL;
+}
+
+/*
+* Writes the whole tree to a tar archive, without stopping the commands.
+* The child process gets a copy of the tree as it is now (the memory is
+* copied by the kernel only when one of the processes writes a page), so
+* the caller only pays for fork(), whatever the size of the tree; the
+* time of fork() is given in "stall".
+*
+* Returns STATUS_BUSY if a checkpoint is still being written or if a
+* transaction is in progress, STATUS_IO if the process can not be made.
+*/
+int checkpoint_start(TreeNode *root, const char *path, double *stall) {
+    if (strlen(path) == 0)
+        path = CHECKPOINT_DEFAULT_PATH;
+    if (running.pid || undo_active())
+        return STATUS_BUSY;
+
+    while (root->parent)
+        root = root->parent;
+
+    int fds[2];
+    if (pipe(fds) < 0)
+        return STATUS_IO;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pid_t pid = fork();
+    if (pid < 0) {
+        int error = errno;
+        close(fds[0]);
+        close(fds[1]);
+        errno = error;
+        return STATUS_IO;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        store_fork_child();
+        write_checkpoint(root, path, fds[1]);
+        _exit(0);
+    }
+    *stall = elapsed_ms(&start);
+
+    close(fds[1]);
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    running.pid = pid;
+    running.fd = fds[0];
+    running.path = strdup(path);
+    running.done = 0;
+    return STATUS_OK;
+}
@@ -0,0 +1,40 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "export.h"
+
+#define CHECKPOINT_DEFAULT_PATH "checkpoint.tar"
+
+typedef struct CheckpointReport CheckpointReport;
+
+enum ReportType {
+    REPORT_PROGRESS,
+    REPORT_DONE,
+    REPORT_FAILED
+};
+
+/*
+* The child sends fixed-size reports through a pipe. They are much
+* smaller than PIPE_BUF, so every write() sends a whole report.
+*/
+struct CheckpointReport {
+    int type;
+    int error;
+    size_t nr_of_nodes, total;
+    ExportStats stats;
+    double elapsed;
+};
+
+typedef void (*CheckpointResult)(const CheckpointReport* report,
+                                 const char* path, void* arg);
+
+/*
+* A checkpoint is written by a child process, so the caller only waits
+* for fork(). checkpoint_poll() gives the reports sent by the child since
+* the last call; with "wait" set, it blocks until the child is done.
+*/
+int checkpoint_start(TreeNode* root, const char* path, double* stall);
+const char* checkpoint_path(void);
+void checkpoint_poll(int wait, CheckpointResult result, void* arg);
+
+#endif  // CHECKPOINT_H
@@ -0,0 +1,392 @@
+// Copyright Avram Cristian - Stefan 2022 stefanavram93@gmail.com
+// Copyright Dumitrescu Rares - Matei 2022 mateidum828@gmail.com
+
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "export.h"
+
+#define TAR_BLOCK_SIZE 512
+#define TAR_NAME_LEN 100
+#define TAR_PREFIX_LEN 155
+#define EXPORT_BUFFER_SIZE (1 << 20)
+#define EXPORT_PROGRESS_STEP 1024
+
+typedef struct TarHeader TarHeader;
+typedef struct ExportStream ExportStream;
+
+// The header of a POSIX (ustar) archive entry
+struct TarHeader {
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];
+    char mtime[12];
+    char chksum[8];
+    char typeflag;
+    char linkname[100];
+    char magic[6];
+    char version[2];
+    char uname[32];
+    char gname[32];
+    char devmajor[8];
+    char devminor[8];
+    char prefix[155];
+    char pad[12];
+};
+
+/*
+* The state of one export. The same write buffer and the same path
+* buffer are used for every entry, so no memory is allocated per file.
+*/
+struct ExportStream {
+    int fd;
+    char* buffer;
+    size_t used;
+    char* path;
+    size_t path_len, path_size;
+    long mtime;
+    int failed;
+    ExportStats stats;
+    ExportProgress progress;  // called every EXPORT_PROGRESS_STEP entries
+    void* progress_arg;
+};
+
+static void write_all(ExportStream *stream, const char *data, size_t size) {
+    while (size && !stream->failed) {
+        ssize_t bytes = write(stream->fd, data, size);
+        if (bytes < 0) {
+            if (errno == EINTR)
+                continue;
+            stream->failed = 1;
+            return;
+        }
+        data += bytes;
+        size -= bytes;
+    }
+}
+
+static void flush_stream(ExportStream *stream) {
+    write_all(stream, stream->buffer, stream->used);
+    stream->used = 0;
+}
+
+/*
+* Adds data to the write buffer. Data that is bigger than the buffer
+* is written directly, after the buffer is flushed, so it is not copied.
+*/
+static void stream_write(ExportStream *stream, const char *data,
+                         size_t size) {
+    if (stream->used + size > EXPORT_BUFFER_SIZE)
+        flush_stream(stream);
+
+    if (size >= EXPORT_BUFFER_SIZE) {
+        write_all(stream, data, size);
+        return;
+    }
+    memcpy(stream->buffer + stream->used, data, size);
+    stream->used += size;
+}
+
+static const char zero_block[TAR_BLOCK_SIZE];
+
+// The entries of an archive are padded to a multiple of 512 bytes
+static void stream_pad(ExportStream *stream, size_t size) {
+    size_t rest = size % TAR_BLOCK_SIZE;
+    if (rest)
+        stream_write(stream, zero_block, TAR_BLOCK_SIZE - rest);
+}
+
+// Adds "/name" to the path of the current entry
+static size_t push_name(ExportStream *stream, const char *name) {
+    size_t old_len = stream->path_len, name_len = strlen(name);
+
+    if (old_len + name_len + 2 > stream->path_size) {
+        stream->path_size = 2 * (old_len + name_len + 2);
+        stream->path = realloc(stream->path, stream->path_size);
+    }
+    if (old_len)
+        stream->path[stream->path_len++] = '/';
+    memcpy(stream->path + stream->path_len, name, name_len + 1);
+    stream->path_len += name_len;
+    return old_len;
+}
+
+static inline void pop_name(ExportStream *stream, size_t old_len) {
+    stream->path_len = old_len;
+    stream->path[old_len] = '\0';
+}
+
+static void write_header(ExportStream *stream, const char *name,
+                         size_t name_len, char type, size_t size,
+                         const char *link) {
+    TarHeader header;
+    memset(&header, 0, sizeof(header));
+
+    // the target of a symbolic link gets the same treatment as the name
+    if (link) {
+        size_t link_len = strlen(link);
+        if (link_len > TAR_NAME_LEN) {
+            write_header(stream, "././@LongLink", 13, 'K', link_len + 1,
+                         NULL);
+            stream_write(stream, link, link_len + 1);
+            stream_pad(stream, link_len + 1);
+            link_len = TAR_NAME_LEN;
+        }
+        memcpy(header.linkname, link, link_len);
+    }
+
+    /*
+    * A name that does not fit in the header is split between "prefix"
+    * and "name" at a '/'. If this is not possible either, the GNU
+    * "././@LongLink" entry is written before the header.
+    */
+    if (name_len > TAR_NAME_LEN) {
+        size_t split = name_len - TAR_NAME_LEN - 1;
+        while (split < name_len && name[split] != '/')
+            split++;
+
+        if (split <= TAR_PREFIX_LEN && split < name_len) {
+            memcpy(header.prefix, name, split);
+            name += split + 1;
+            name_len -= split + 1;
+        } else {
+            write_header(stream, "././@LongLink", 13, 'L', name_len + 1,
+                         NULL);
+            stream_write(stream, name, name_len + 1);
+            stream_pad(stream, name_len + 1);
+            name_len = TAR_NAME_LEN;
+        }
+    }
+    memcpy(header.name, name, name_len);
+
+    snprintf(header.mode, sizeof(header.mode), "%07o",
+             type == '5' || type == '2' ? 0755 : 0644);
+    snprintf(header.uid, sizeof(header.uid), "%07o", 0);
+    snprintf(header.gid, sizeof(header.gid), "%07o", 0);
+    snprintf(header.size, sizeof(header.size), "%011lo",
+             (unsigned long)size);
+    snprintf(header.mtime, sizeof(header.mtime), "%011lo",
+             (unsigned long)stream->mtime);
+    header.typeflag = type;
+    memcpy(header.magic, "ustar", 6);
+    memcpy(header.version, "00", 2);
+
+    // the checksum is computed with its own field filled with spaces
+    memset(header.chksum, ' ', sizeof(header.chksum));
+    unsigned int sum = 0;
+    for (size_t i = 0; i < sizeof(header); i++)
+        sum += ((unsigned char *)&header)[i];
+    snprintf(header.chksum, sizeof(header.chksum), "%06o", sum);
+
+    stream_write(stream, (char *)&header, sizeof(header));
+}
+
+/*
+* Writes the node and everything that it contains in the archive.
+* Directory names end with '/', as tar expects.
+*/
+static void export_tar(ExportStream *stream, TreeNode *node) {
+    size_t old_len = push_name(stream, node->name);
+
+    if (node->type == FILE_NODE) {
+        FileContent *file_content = node->content;
+        size_t size = file_content->body->size;
+        const char *text = blob_text(file_content->body);
+
+        if (!text) {
+            stream->failed = 1;
+        } else {
+            write_header(stream, stream->path, stream->path_len, '0', size,
+                         NULL);
+            stream_write(stream, text, size);
+            stream_pad(stream, size);
+            stream->stats.nr_of_files++;
+            stream->stats.nr_of_bytes += size;
+        }
+    } else if (node->type == SYMLINK_NODE) {
+        LinkContent *link_content = node->content;
+        write_header(stream, stream->path, stream->path_len, '2', 0,
+                     link_content->target);
+        stream->stats.nr_of_files++;
+    } else {
+        stream->path[stream->path_len] = '/';
+        write_header(stream, stream->path, stream->path_len + 1, '5', 0,
+                     NULL);
+        stream->path[stream->path_len] = '\0';
+        stream->stats.nr_of_dir++;
+    }
+
+    if (stream->progress && (stream->stats.nr_of_dir +
+                             stream->stats.nr_of_files) %
+                            EXPORT_PROGRESS_STEP == 0)
+        stream->progress(&stream->stats, stream->progress_arg);
+
+    if (node->type == FOLDER_NODE) {
+        FolderContent *directory_content = node->content;
+        if (directory_content) {
+            for (ListNode *child = directory_content->children->head;
+                 child && !stream->failed; child = child->next)
+                export_tar(stream, child->info);
+        }
+    }
+    pop_name(stream, old_len);
+}
+
+/*
+* Writes the archive of a subtree to an open descriptor, which is left
+* open. The progress function (if any) is called every
+* EXPORT_PROGRESS_STEP entries, with the entries written so far.
+*
+* Returns 0, or -1 if a write failed (errno tells why).
+*/
+int write_archive(TreeNode *node, int fd, ExportProgress progress,
+                  void *progressArg, ExportStats *stats) {
+    ExportStream stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.fd = fd;
+    stream.mtime = time(NULL);
+    stream.progress = progress;
+    stream.progress_arg = progressArg;
+    stream.buffer = malloc(EXPORT_BUFFER_SIZE);
+    stream.path_size = 256;
+    stream.path = malloc(stream.path_size);
+    stream.path[0] = '\0';
+
+    export_tar(&stream, node);
+
+    // the archive ends with two empty blocks
+    stream_write(&stream, zero_block, TAR_BLOCK_SIZE);
+    stream_write(&stream, zero_block, TAR_BLOCK_SIZE);
+    flush_stream(&stream);
+    free(stream.buffer);
+    free(stream.path);
+
+    if (stats)
+        *stats = stream.stats;
+    return stream.failed ? -1 : 0;
+}
+
+/*
+* Tells if the entry that was already in the host directory is the one
+* that would be created: a directory, or a link to the same target.
+* Otherwise it is left as it is and errno is set to EEXIST.
+*/
+static int same_entry(int dir_fd, const char *name, mode_t type,
+                      const char *target) {
+    struct stat st;
+    if (fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) < 0)
+        return 0;
+
+    if ((st.st_mode & S_IFMT) == type && !target)
+        return 1;
+    if ((st.st_mode & S_IFMT) == type) {
+        size_t len = strlen(target);
+        char *old = malloc(len + 1);
+        ssize_t old_len = readlinkat(dir_fd, name, old, len + 1);
+        int same = old_len == (ssize_t)len && !memcmp(old, target, len);
+        free(old);
+        if (same)
+            return 1;
+    }
+    errno = EEXIST;
+    return 0;
+}
+
+/*
+* Recreates the node inside the host directory "dir_fd". The children
+* are created relative to the descriptor of their directory, so no
+* full host path has to be built.
+*
+* The links of the host are never followed: a file replaces only a
+* regular file, and an existing folder or link is kept only if it is
+* what would be created.
+*/
+static void export_host(ExportStream *stream, int dir_fd, TreeNode *node) {
+    if (node->type == FILE_NODE) {
+        FileContent *file_content = node->content;
+        size_t size = file_content->body->size;
+        const char *text = blob_text(file_content->body);
+        if (!text) {
+            stream->failed = 1;
+            return;
+        }
+
+        // O_NONBLOCK fails on a pipe without readers instead of waiting
+        stream->fd = openat(dir_fd, node->name, O_WRONLY | O_CREAT |
+                            O_TRUNC | O_NOFOLLOW | O_NONBLOCK, 0644);
+        struct stat st;
+        if (stream->fd >= 0 && (fstat(stream->fd, &st) < 0 ||
+                                !S_ISREG(st.st_mode))) {
+            close(stream->fd);
+            stream->fd = -1;
+            errno = EEXIST;
+        }
+        if (stream->fd < 0) {
+            stream->failed = 1;
+            return;
+        }
+        write_all(stream, text, size);
+        close(stream->fd);
+        stream->stats.nr_of_files++;
+        stream->stats.nr_of_bytes += size;
+        return;
+    }
+
+    if (node->type == SYMLINK_NODE) {
+        LinkContent *link_content = node->content;
+        if (symlinkat(link_content->target, dir_fd, node->name) < 0 &&
+            (errno != EEXIST || !same_entry(dir_fd, node->name, S_IFLNK,
+                                            link_content->target))) {
+            stream->failed = 1;
+            return;
+        }
+        stream->stats.nr_of_files++;
+        return;
+    }
+
+    if (mkdirat(dir_fd, node->name, 0755) < 0 &&
+        (errno != EEXIST || !same_entry(dir_fd, node->name, S_IFDIR,
+                                        NULL))) {
+        stream->failed = 1;
+        return;
+    }
+    int child_fd = openat(dir_fd, node->name,
+                          O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+    if (child_fd < 0) {
+        stream->failed = 1;
+        return;
+    }
+    stream->stats.nr_of_dir++;
+
+    FolderContent *directory_content = node->content;
+    if (directory_content) {
+        for (ListNode *child = directory_content->children->head;
+             child && !stream->failed; child = child->next)
+            export_host(stream, child_fd, child->info);
+    }
+    close(child_fd);
+}
+
+/*
+* Recreates the node inside the host directory "dir_fd", the way
+* write_archive() writes it to an archive. Returns -1 (with errno set)
+* if the host file system fails.
+*/
+int export_dir(TreeNode *node, int dir_fd, ExportStats *stats) {
+    ExportStream stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.mtime = time(NULL);
+
+    export_host(&stream, dir_fd, node);
+    if (stats)
+        *stats = stream.stats;
+    return stream.failed ? -1 : 0;
+}
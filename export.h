@@ -0,0 +1,23 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include "node.h"
+
+typedef struct ExportStats ExportStats;
+
+struct ExportStats {
+    int nr_of_dir, nr_of_files;
+    size_t nr_of_bytes;
+};
+
+typedef void (*ExportProgress)(const ExportStats* stats, void* arg);
+
+/*
+* The archive writer of *export*, also used by *checkpoint*, which runs
+* it in a child process.
+*/
+int write_archive(TreeNode* node, int fd, ExportProgress progress,
+                  void* progressArg, ExportStats* stats);
+int export_dir(TreeNode* node, int dir_fd, ExportStats* stats);
+
+#endif  // EXPORT_H
@@ -0,0 +1,339 @@
+// Copyright Avram Cristian - Stefan 2022 stefanavram93@gmail.com
+// Copyright Dumitrescu Rares - Matei 2022 mateidum828@gmail.com
+
+#define _DEFAULT_SOURCE
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "import.h"
+#include "search.h"
+
+#define IMPORT_MAX_THREADS 16
+#define HOST_NAME_MAX_LEN 256
+#define HOST_LINK_MAX_LEN 4096
+
+typedef struct ImportTask ImportTask;
+typedef struct ImportQueue ImportQueue;
+
+/*
+* Every task reads one host directory and fills the children of "folder".
+* The folder is not visible in the tree yet, so only its task changes it.
+*/
+struct ImportTask {
+    TreeNode* folder;
+    char* host_path;
+    ImportTask* next;
+};
+
+struct ImportQueue {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    ImportTask* head;
+    int pending;  // tasks that are queued or still running
+    int nr_of_dir, nr_of_files, nr_of_links, nr_skipped;
+};
+
+/*
+* Reads a whole host file into a single buffer, which is given to the
+* content store, so the data is copied only once (the buffer is freed
+* by the store if the same text already exists).
+*
+* Returns NULL if the file can not be read.
+*/
+static Blob *read_host_file(int dir_fd, const char *name) {
+    int fd = openat(dir_fd, name, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = st.st_size, length = 0;
+    char *text = malloc(size + 1);
+    ssize_t bytes = 0;
+
+    // only the size seen by fstat is read, even if the file grows meanwhile
+    while (length < size &&
+           (bytes = read(fd, text + length, size - length)) > 0)
+        length += bytes;
+    close(fd);
+
+    if (bytes < 0) {
+        free(text);
+        return NULL;
+    }
+    text[length] = '\0';
+    return store_intern_buffer(text, length);
+}
+
+static char *join_path(const char *dir, const char *name) {
+    size_t dir_len = strlen(dir), name_len = strlen(name);
+    char *path = malloc(dir_len + name_len + 2);
+
+    memcpy(path, dir, dir_len);
+    path[dir_len] = '/';
+    memcpy(path + dir_len + 1, name, name_len + 1);
+    return path;
+}
+
+/*
+* Reads the entries of one host directory. The new nodes are linked in
+* a local list that is given to the folder at the end, in a single step,
+* and the subdirectories are returned as new tasks.
+*/
+static ImportTask *import_folder(ImportTask *task, int *nr_of_dir,
+                                 int *nr_of_files, int *nr_of_links,
+                                 int *nr_skipped) {
+    DIR *dir = opendir(task->host_path);
+    if (!dir) {
+        (*nr_skipped)++;
+        return NULL;
+    }
+
+    ListNode *head = NULL, *tail = NULL;
+    ImportTask *subtasks = NULL;
+    struct dirent *entry;
+
+    while ((entry = readdir(dir)) != NULL) {
+        char *name = entry->d_name;
+        if (!strcmp(name, ".") || !strcmp(name, ".."))
+            continue;
+
+        unsigned char type = entry->d_type;
+        if (type == DT_UNKNOWN) {
+            struct stat st;
+            if (fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) < 0)
+                type = DT_UNKNOWN;
+            else if (S_ISDIR(st.st_mode))
+                type = DT_DIR;
+            else if (S_ISREG(st.st_mode))
+                type = DT_REG;
+            else if (S_ISLNK(st.st_mode))
+                type = DT_LNK;
+        }
+
+        TreeNode *node;
+        if (type == DT_REG) {
+            Blob *body = read_host_file(dirfd(dir), name);
+            if (!body) {
+                (*nr_skipped)++;
+                continue;
+            }
+            node = new_node(name, FILE_NODE, new_file_content(body));
+            (*nr_of_files)++;
+        } else if (type == DT_LNK) {
+            // the target is kept as it is, so relative links still work
+            char target[HOST_LINK_MAX_LEN];
+            ssize_t len = readlinkat(dirfd(dir), name, target,
+                                     sizeof(target) - 1);
+            if (len <= 0) {
+                (*nr_skipped)++;
+                continue;
+            }
+            target[len] = '\0';
+            node = new_node(name, SYMLINK_NODE, new_link_content(target));
+            (*nr_of_links)++;
+        } else if (type == DT_DIR) {
+            node = new_node(name, FOLDER_NODE, NULL);
+            ImportTask *subtask = malloc(sizeof(ImportTask));
+            subtask->folder = node;
+            subtask->host_path = join_path(task->host_path, name);
+            subtask->next = subtasks;
+            subtasks = subtask;
+            (*nr_of_dir)++;
+        } else {
+            // devices, sockets and pipes are not imported
+            (*nr_skipped)++;
+            continue;
+        }
+
+        node->parent = task->folder;
+        ListNode *content_node = malloc(sizeof(ListNode));
+        content_node->info = node;
+        content_node->next = NULL;
+        if (tail)
+            tail->next = content_node;
+        else
+            head = content_node;
+        tail = content_node;
+    }
+    closedir(dir);
+
+    if (head) {
+        FolderContent *directory_content = malloc(sizeof(FolderContent));
+        directory_content->children = malloc(sizeof(List));
+        directory_content->children->head = head;
+        directory_content->children->tail = tail;
+        directory_content->index = NULL;
+        task->folder->content = directory_content;
+    }
+    return subtasks;
+}
+
+/*
+* Every worker takes tasks from the queue until there are no tasks
+* left and none of the other workers may add new ones.
+*/
+static void *import_worker(void *arg) {
+    ImportQueue *queue = arg;
+
+    pthread_mutex_lock(&queue->lock);
+    while (1) {
+        while (!queue->head && queue->pending)
+            pthread_cond_wait(&queue->wake, &queue->lock);
+        if (!queue->head)
+            break;
+
+        ImportTask *task = queue->head;
+        queue->head = task->next;
+        pthread_mutex_unlock(&queue->lock);
+
+        int nr_of_dir = 0, nr_of_files = 0, nr_of_links = 0, nr_skipped = 0;
+        ImportTask *subtasks = import_folder(task, &nr_of_dir, &nr_of_files,
+                                             &nr_of_links, &nr_skipped);
+        free(task->host_path);
+        free(task);
+
+        pthread_mutex_lock(&queue->lock);
+        queue->nr_of_dir += nr_of_dir;
+        queue->nr_of_files += nr_of_files;
+        queue->nr_of_links += nr_of_links;
+        queue->nr_skipped += nr_skipped;
+        queue->pending--;
+
+        while (subtasks) {
+            ImportTask *next = subtasks->next;
+            subtasks->next = queue->head;
+            queue->head = subtasks;
+            queue->pending++;
+            subtasks = next;
+        }
+        pthread_cond_broadcast(&queue->wake);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+/*
+* Reads the host directory with a pool of threads. The folder given as
+* root is filled while it is still detached from the tree.
+*/
+static void import_host_folder(TreeNode *root, const char *host_path,
+                               ImportQueue *queue) {
+    long nr_of_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nr_of_threads < 1)
+        nr_of_threads = 1;
+    if (nr_of_threads > IMPORT_MAX_THREADS)
+        nr_of_threads = IMPORT_MAX_THREADS;
+
+    ImportTask *task = malloc(sizeof(ImportTask));
+    task->folder = root;
+    task->host_path = malloc(strlen(host_path) + 1);
+    memcpy(task->host_path, host_path, strlen(host_path) + 1);
+    task->next = NULL;
+
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->wake, NULL);
+    queue->head = task;
+    queue->pending = 1;
+
+    pthread_t threads[IMPORT_MAX_THREADS];
+    for (long i = 0; i < nr_of_threads; i++)
+        pthread_create(&threads[i], NULL, import_worker, queue);
+    for (long i = 0; i < nr_of_threads; i++)
+        pthread_join(threads[i], NULL);
+
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->wake);
+}
+
+/*
+* Copies the last component of the path, without trailing '/', to
+* "name". Returns -1 if there is none or it is too long.
+*/
+static int last_component(const char *path, char *name) {
+    size_t end = strlen(path), start;
+    while (end > 1 && path[end - 1] == '/')
+        end--;
+    start = end;
+    while (start > 0 && path[start - 1] != '/')
+        start--;
+    if (end - start == 0 || end - start >= HOST_NAME_MAX_LEN)
+        return -1;
+    memcpy(name, path + start, end - start);
+    name[end - start] = '\0';
+    return 0;
+}
+
+/*
+* The name of the new node. "." and ".." would name a node that no path
+* can reach, so the real name of the directory is taken for them.
+*/
+static int host_name(const char *hostPath, char *name) {
+    if (last_component(hostPath, name) < 0)
+        return -1;
+    if (strcmp(name, ".") && strcmp(name, ".."))
+        return 0;
+
+    char *real = realpath(hostPath, NULL);
+    // the root of the host has no last component, so it fails too
+    int result = real ? last_component(real, name) : -1;
+    free(real);
+    return result;
+}
+
+/*
+* Copies a directory (or a file) of the host file system into the
+* folder. The new node gets the name of the last component of the host
+* path and it is linked in the tree only after all of its content was
+* read.
+*/
+int import_host(TreeNode *folder, const char *hostPath, ImportStats *stats) {
+    if (folder->type != FOLDER_NODE)
+        return STATUS_NOT_DIR;
+
+    struct stat st;
+    if (stat(hostPath, &st) < 0)
+        return STATUS_NO_ENTRY;
+
+    char name[HOST_NAME_MAX_LEN];
+    if (host_name(hostPath, name) < 0)
+        return STATUS_INVALID;
+
+    if (find_child(folder, name, NULL))
+        return STATUS_EXISTS;
+
+    ImportQueue queue = {.head = NULL, .pending = 0, .nr_of_dir = 0,
+                         .nr_of_files = 0, .nr_of_links = 0,
+                         .nr_skipped = 0};
+    TreeNode *node;
+
+    if (S_ISDIR(st.st_mode)) {
+        node = new_node(name, FOLDER_NODE, NULL);
+        import_host_folder(node, hostPath, &queue);
+        queue.nr_of_dir++;
+    } else if (S_ISREG(st.st_mode)) {
+        Blob *body = read_host_file(AT_FDCWD, hostPath);
+        if (!body)
+            return STATUS_IO;
+        node = new_node(name, FILE_NODE, new_file_content(body));
+        queue.nr_of_files++;
+    } else {
+        return STATUS_UNSUPPORTED;
+    }
+
+    append_child(folder, node);
+    search_add(node);
+    stats->nr_of_dir = queue.nr_of_dir;
+    stats->nr_of_files = queue.nr_of_files;
+    stats->nr_of_links = queue.nr_of_links;
+    stats->nr_skipped = queue.nr_skipped;
+    return STATUS_OK;
+}
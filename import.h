@@ -0,0 +1,21 @@
+#ifndef IMPORT_H
+#define IMPORT_H
+
+#include "node.h"
+
+typedef struct ImportStats ImportStats;
+
+struct ImportStats {
+    int nr_of_dir, nr_of_files;
+    int nr_of_links;  // the symbolic links, which are not files for du
+    int nr_skipped;  // the host entries that could not be read
+};
+
+/*
+* The reader of *import*. Returns a STATUS_* code; STATUS_IO if the host
+* file can not be read, STATUS_UNSUPPORTED if it is a device, a socket
+* or a pipe.
+*/
+int import_host(TreeNode* folder, const char* hostPath, ImportStats* stats);
+
+#endif  // IMPORT_H
@@ -0,0 +1,181 @@
+// Copyright Avram Cristian - Stefan 2022 stefanavram93@gmail.com
+// Copyright Dumitrescu Rares - Matei 2022 mateidum828@gmail.com
+
+#include <stdlib.h>
+#include <string.h>
+#include "index.h"
+
+/*
+* The index is a skip list ordered by the names of the children.
+*
+* Every link keeps the number of entries it jumps over, so besides
+* the usual logarithmic search, insert and remove, the entry found at
+* a given position of the sorted order can be reached in logarithmic
+* time (used for paged listings).
+*/
+static IndexNode *alloc_node(TreeNode *info, int height) {
+    IndexNode *node = malloc(sizeof(IndexNode) + height * sizeof(IndexLink));
+    node->info = info;
+    node->height = height;
+    for (int i = 0; i < height; i++) {
+        node->link[i].next = NULL;
+        node->link[i].span = 0;
+    }
+    return node;
+}
+
+// Every level is kept with a probability of 1/4 (xorshift generator)
+static int random_height(NameIndex *index) {
+    int height = 1;
+    unsigned int x = index->seed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    index->seed = x;
+
+    while (height < INDEX_MAX_LEVEL && (x & 3) == 0) {
+        height++;
+        x >>= 2;
+    }
+    return height;
+}
+
+NameIndex *index_create(void) {
+    NameIndex *index = malloc(sizeof(NameIndex));
+    index->head = alloc_node(NULL, INDEX_MAX_LEVEL);
+    index->level = 1;
+    index->size = 0;
+    index->seed = 2463534242u;
+    return index;
+}
+
+void index_free(NameIndex *index) {
+    if (!index)
+        return;
+
+    IndexNode *node = index->head, *next;
+    while (node) {
+        next = node->link[0].next;
+        free(node);
+        node = next;
+    }
+    free(index);
+}
+
+/*
+* Searches the last node of every level that is placed before "name".
+* The positions of these nodes are stored in "rank".
+*/
+static void find_before(NameIndex *index, const char *name,
+                        IndexNode **update, unsigned int *rank) {
+    IndexNode *node = index->head;
+
+    for (int i = index->level - 1; i >= 0; i--) {
+        rank[i] = i == index->level - 1 ? 0 : rank[i + 1];
+        while (node->link[i].next &&
+               strcmp(node->link[i].next->info->name, name) < 0) {
+            rank[i] += node->link[i].span;
+            node = node->link[i].next;
+        }
+        update[i] = node;
+    }
+}
+
+void index_insert(NameIndex *index, TreeNode *info) {
+    IndexNode *update[INDEX_MAX_LEVEL];
+    unsigned int rank[INDEX_MAX_LEVEL];
+
+    find_before(index, info->name, update, rank);
+
+    int height = random_height(index);
+    if (height > index->level) {
+        for (int i = index->level; i < height; i++) {
+            rank[i] = 0;
+            update[i] = index->head;
+            update[i]->link[i].span = index->size;
+        }
+        index->level = height;
+    }
+
+    IndexNode *node = alloc_node(info, height);
+    for (int i = 0; i < height; i++) {
+        node->link[i].next = update[i]->link[i].next;
+        update[i]->link[i].next = node;
+
+        node->link[i].span = update[i]->link[i].span - (rank[0] - rank[i]);
+        update[i]->link[i].span = rank[0] - rank[i] + 1;
+    }
+
+    // the links that are passing over the new node are now longer
+    for (int i = height; i < index->level; i++)
+        update[i]->link[i].span++;
+
+    index->size++;
+}
+
+void index_remove(NameIndex *index, TreeNode *info) {
+    IndexNode *update[INDEX_MAX_LEVEL];
+    unsigned int rank[INDEX_MAX_LEVEL];
+
+    find_before(index, info->name, update, rank);
+
+    IndexNode *node = update[0]->link[0].next;
+    if (!node || node->info != info)
+        return;
+
+    for (int i = 0; i < index->level; i++) {
+        if (update[i]->link[i].next == node) {
+            update[i]->link[i].span += node->link[i].span - 1;
+            update[i]->link[i].next = node->link[i].next;
+        } else {
+            update[i]->link[i].span--;
+        }
+    }
+
+    while (index->level > 1 && !index->head->link[index->level - 1].next)
+        index->level--;
+
+    index->size--;
+    free(node);
+}
+
+// Returns the entry found on the given position (0 is the first entry)
+IndexNode *index_at(NameIndex *index, unsigned int offset) {
+    if (offset >= index->size)
+        return NULL;
+
+    IndexNode *node = index->head;
+    unsigned int traversed = 0;
+
+    for (int i = index->level - 1; i >= 0; i--) {
+        while (node->link[i].next &&
+               traversed + node->link[i].span <= offset + 1) {
+            traversed += node->link[i].span;
+            node = node->link[i].next;
+        }
+        if (traversed == offset + 1)
+            return node;
+    }
+    return NULL;
+}
+
+// Returns the first entry whose name is not smaller than the key
+IndexNode *index_seek(NameIndex *index, const char *key) {
+    IndexNode *node = index->head;
+
+    for (int i = index->level - 1; i >= 0; i--) {
+        while (node->link[i].next &&
+               strcmp(node->link[i].next->info->name, key) < 0)
+            node = node->link[i].next;
+    }
+    return node->link[0].next;
+}
+
+IndexNode *index_first(NameIndex *index) {
+    return index->head->link[0].next;
+}
+
+IndexNode *index_next(IndexNode *node) {
+    return node->link[0].next;
+}
@@ -0,0 +1,42 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "node.h"
+
+#define INDEX_MAX_LEVEL 24
+
+typedef struct IndexNode IndexNode;
+typedef struct IndexLink IndexLink;
+
+/*
+* "span" is the number of entries that are skipped by following "next",
+* so the position of an entry can be found while descending the levels.
+*/
+struct IndexLink {
+    IndexNode* next;
+    unsigned int span;
+};
+
+struct IndexNode {
+    TreeNode* info;
+    int height;
+    IndexLink link[];
+};
+
+struct NameIndex {
+    IndexNode* head;
+    int level;
+    unsigned int size;
+    unsigned int seed;
+};
+
+NameIndex* index_create(void);
+void index_free(NameIndex* index);
+void index_insert(NameIndex* index, TreeNode* info);
+void index_remove(NameIndex* index, TreeNode* info);
+IndexNode* index_at(NameIndex* index, unsigned int offset);
+IndexNode* index_seek(NameIndex* index, const char* key);
+IndexNode* index_first(NameIndex* index);
+IndexNode* index_next(IndexNode* node);
+
+#endif  // INDEX_H
@@ -0,0 +1,189 @@
+// Copyright Avram Cristian - Stefan 2022 stefanavram93@gmail.com
+// Copyright Dumitrescu Rares - Matei 2022 mateidum828@gmail.com
+
+#include <stdint.h>
+#include <string.h>
+#include "lz.h"
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+#define LZ_MAX_OFFSET 65535
+#define LZ_RUN_MASK 15
+
+/*
+* A byte-oriented LZ77 codec, with the sequence format of LZ4: a token
+* byte keeps the number of literals (high 4 bits) and the length of the
+* match minus 4 (low 4 bits); a value of 15 is continued by extra bytes,
+* added up until one of them is not 255. The literals follow, then the
+* 2-byte offset of the match (little endian) and the extra length bytes.
+*
+* The last sequence has only literals. The decoder knows the size of the
+* text, so it stops when the text is complete.
+*/
+static inline uint32_t hash4(const unsigned char *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return (value * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+// Returns NULL if there is no room for the extra length bytes
+static unsigned char *put_length(unsigned char *out, unsigned char *end,
+                                 size_t len) {
+    for (; len >= 255; len -= 255) {
+        if (out == end)
+            return NULL;
+        *out++ = 255;
+    }
+    if (out == end)
+        return NULL;
+    *out++ = len;
+    return out;
+}
+
+static unsigned char *put_sequence(unsigned char *out, unsigned char *end,
+                                   const unsigned char *literals,
+                                   size_t nr_of_literals, size_t offset,
+                                   size_t match_len) {
+    if (out == end)
+        return NULL;
+
+    unsigned char *token = out++;
+    size_t lit_code = nr_of_literals < LZ_RUN_MASK ? nr_of_literals
+                                                   : LZ_RUN_MASK;
+    size_t match_code = 0;
+    if (match_len)
+        match_code = match_len - LZ_MIN_MATCH < LZ_RUN_MASK ?
+                     match_len - LZ_MIN_MATCH : LZ_RUN_MASK;
+    *token = lit_code << 4 | match_code;
+
+    if (lit_code == LZ_RUN_MASK &&
+        !(out = put_length(out, end, nr_of_literals - LZ_RUN_MASK)))
+        return NULL;
+    if ((size_t)(end - out) < nr_of_literals)
+        return NULL;
+    memcpy(out, literals, nr_of_literals);
+    out += nr_of_literals;
+
+    if (!match_len)
+        return out;
+    if (end - out < 2)
+        return NULL;
+    *out++ = offset & 0xff;
+    *out++ = offset >> 8;
+    if (match_code == LZ_RUN_MASK)
+        out = put_length(out, end, match_len - LZ_MIN_MATCH - LZ_RUN_MASK);
+    return out;
+}
+
+/*
+* Compresses the text into "dest". Returns the compressed size, or 0 if
+* it does not fit in "capacity" bytes (so a text that does not get
+* smaller is rejected early).
+*/
+size_t lz_compress(const char *source, size_t size, char *dest,
+                   size_t capacity) {
+    const unsigned char *src = (const unsigned char *)source;
+    const unsigned char *in = src, *anchor = src, *end = src + size;
+    unsigned char *out = (unsigned char *)dest, *out_end = out + capacity;
+    uint32_t table[1 << LZ_HASH_BITS];
+
+    // a stale (or zero) position is harmless, the bytes are compared
+    memset(table, 0, sizeof(table));
+
+    while (end - in >= LZ_MIN_MATCH) {
+        uint32_t h = hash4(in);
+        const unsigned char *ref = src + table[h];
+        table[h] = in - src;
+
+        if (ref >= in || in - ref > LZ_MAX_OFFSET ||
+            memcmp(ref, in, LZ_MIN_MATCH)) {
+            in++;
+            continue;
+        }
+
+        size_t len = LZ_MIN_MATCH;
+        while (in + len < end && ref[len] == in[len])
+            len++;
+
+        out = put_sequence(out, out_end, anchor, in - anchor, in - ref, len);
+        if (!out)
+            return 0;
+        in += len;
+        anchor = in;
+    }
+
+    if (anchor < end) {
+        out = put_sequence(out, out_end, anchor, end - anchor, 0, 0);
+        if (!out)
+            return 0;
+    }
+    return out - (unsigned char *)dest;
+}
+
+// Returns -1 if a length in the data is bigger than the data itself
+static int get_length(const unsigned char **in, const unsigned char *end,
+                      size_t *len) {
+    unsigned char byte;
+    do {
+        if (*in == end)
+            return -1;
+        byte = *(*in)++;
+        *len += byte;
+    } while (byte == 255);
+    return 0;
+}
+
+/*
+* Rebuilds a text of "size" bytes. Returns 0, or -1 if the data is
+* corrupt (nothing is written outside of the text).
+*/
+int lz_decompress(const char *source, size_t packedSize, char *dest,
+                  size_t size) {
+    const unsigned char *in = (const unsigned char *)source;
+    const unsigned char *in_end = in + packedSize;
+    unsigned char *out = (unsigned char *)dest, *out_end = out + size;
+
+    while (out < out_end) {
+        if (in == in_end)
+            return -1;
+        unsigned char token = *in++;
+
+        size_t nr_of_literals = token >> 4;
+        if (nr_of_literals == LZ_RUN_MASK &&
+            get_length(&in, in_end, &nr_of_literals) < 0)
+            return -1;
+        if ((size_t)(in_end - in) < nr_of_literals ||
+            (size_t)(out_end - out) < nr_of_literals)
+            return -1;
+        memcpy(out, in, nr_of_literals);
+        in += nr_of_literals;
+        out += nr_of_literals;
+        if (out == out_end)
+            break;
+
+        if (in_end - in < 2)
+            return -1;
+        size_t offset = in[0] | in[1] << 8;
+        in += 2;
+        size_t match_len = token & LZ_RUN_MASK;
+        if (match_len == LZ_RUN_MASK &&
+            get_length(&in, in_end, &match_len) < 0)
+            return -1;
+        match_len += LZ_MIN_MATCH;
+
+        if (!offset || offset > (size_t)(out - (unsigned char *)dest) ||
+            (size_t)(out_end - out) < match_len)
+            return -1;
+
+        // the match may overlap the bytes that it writes
+        const unsigned char *ref = out - offset;
+        if (offset >= match_len) {
+            memcpy(out, ref, match_len);
+            out += match_len;
+        } else {
+            while (match_len--)
+                *out++ = *ref++;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,14 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+
+// texts shorter than this are never compressed
+#define LZ_MIN_SIZE 64
+
+size_t lz_compress(const char* source, size_t size, char* dest,
+                   size_t capacity);
+int lz_decompress(const char* source, size_t packedSize, char* dest,
+                  size_t size);
+
+#endif  // LZ_H
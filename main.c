@@ -1,11 +1,18 @@
+#define _XOPEN_SOURCE 700
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include "tree.h"
-#define LINE_MAX_LEN 1000
-#define TOKEN_MAX_LEN 300
+#include <unistd.h>
+#include "sdfs.h"
+// commands have at least this many tokens, the missing ones are empty
+#define MIN_TOKENS 4
 
 #define LS "ls"
 #define PWD "pwd"
+#define COMPLETE "complete"
 #define TREE "tree"
 #define CD "cd"
 #define MKDIR "mkdir"
@@ -15,36 +22,1406 @@
 #define RMREC "rmrec"
 #define MV "mv"
 #define CP "cp"
+#define LN "ln"
+#define SYMBOLIC "-s"
+#define IMPORT "import"
+#define EXPORT "export"
+#define DU "du"
+#define SEARCH "search"
+#define BUDGET "budget"
+#define COMPRESS "compress"
+#define BEGIN "begin"
+#define COMMIT "commit"
+#define ABORT "abort"
+#define CHECKPOINT "checkpoint"
+#define WATCH "watch"
+#define UNWATCH "unwatch"
+#define SORTED "-s"
+#define EMPTY_FILES "-e"
 
-void execute_command(char *cmd, char *arg1, char *arg2) {
-    printf("$ %s %s %s\n", cmd, arg1, arg2);
+#define TAR_SUFFIX ".tar"
+#define WATCH_BATCH 64
+
+/*
+* The commands are built on the library API (sdfs.h): the tree only
+* returns statuses and nodes, and every message is written here.
+*/
+
+typedef struct NodeList NodeList;
+typedef struct SearchMatch SearchMatch;
+typedef struct SearchMatches SearchMatches;
+typedef struct RemoveReport RemoveReport;
+typedef struct Watcher Watcher;
+
+// The nodes given by a listing, in the order they were visited
+struct NodeList {
+    SdfsNode** nodes;
+    int count, size;
+};
+
+struct SearchMatch {
+    SdfsNode* node;
+    int depth;
+};
+
+struct SearchMatches {
+    SearchMatch* items;
+    size_t count, size;
+};
+
+// What the messages of a glob removal need
+struct RemoveReport {
+    const char* command;
+    const char* arg;
+    int prefix;
+};
+
+// The watches of the *watch* command, which read the events between commands
+struct Watcher {
+    int id;
+    unsigned int node_id;
+    char* path;
+    SdfsWatch* watch;
+    Watcher* next;
+};
+
+// number of messages printed by the current command
+static int nr_of_messages;
+
+static Watcher *watchers;
+static int last_watcher_id;
+
+static const char *event_names[] = {"create", "delete", "modify",
+                                    "moved_from", "moved_to"};
+
+// Every message of a command, after the first one, starts on a new line
+static inline void begin_message(void) {
+    if (nr_of_messages++)
+        printf("\n");
+}
+
+static inline void reset_messages(void) {
+    nr_of_messages = 0;
+}
+
+static int collect_node(SdfsNode *node, int depth, void *arg) {
+    NodeList *list = arg;
+    (void)depth;
+
+    if (list->count == list->size) {
+        list->size = list->size ? 2 * list->size : 16;
+        list->nodes = realloc(list->nodes, list->size * sizeof(SdfsNode *));
+    }
+    list->nodes[list->count++] = node;
+    return 0;
+}
+
+// The children of a folder, in the order they were added
+static NodeList list_children(SdfsNode *folder) {
+    NodeList list = {.nodes = NULL, .count = 0, .size = 0};
+    sdfs_list(folder, collect_node, &list);
+    return list;
+}
+
+/*
+* Returns the text of a file (or of the file behind a link), or NULL
+* with the status in "status" if it can not be read.
+*/
+static char *read_text(SdfsNode *node, SdfsStatus *status) {
+    size_t length;
+    *status = sdfs_read(node, NULL, 0, &length);
+    if (*status != SDFS_RANGE)
+        return NULL;
+
+    char *text = malloc(length + 1);
+    *status = sdfs_read(node, text, length + 1, NULL);
+    return text;
+}
+
+// Prints a file like *ls* does, under the name it was found by
+static void print_file(SdfsNode *entry, SdfsNode *file) {
+    SdfsStatus status;
+    char *text = read_text(file, &status);
+
+    if (text)
+        printf("%s: %s\n", sdfs_name(entry), text);
+    else
+        printf("ls: cannot read '%s': %s\n", sdfs_name(entry),
+               sdfs_strerror(status));
+    free(text);
+}
+
+/*
+* The length of the folder part of a glob argument ("dir/sub/" in
+* "dir/sub/log_*"), printed before the matched names.
+*/
+static int glob_prefix(const char *arg) {
+    const char *slash = strrchr(arg, '/');
+    return slash ? slash - arg + 1 : 0;
+}
+
+static NodeList glob_matches(SdfsNode *currentNode, const char *arg) {
+    NodeList matches = {.nodes = NULL, .count = 0, .size = 0};
+    sdfs_glob(currentNode, arg, collect_node, &matches);
+    return matches;
+}
+
+/*
+* Prints the children of a folder in reverse, from the last added node
+* to the first one, separated by newlines.
+*/
+static void print_children(NodeList *children) {
+    for (int i = children->count - 1; i >= 0; i--) {
+        printf("%s", sdfs_name(children->nodes[i]));
+        if (i)
+            printf("\n");
+    }
+}
+
+/*
+* Prints the names that match the pattern, in the same order as *ls*
+* (from the last added node to the first one).
+*/
+static void ls_matching(SdfsNode *currentNode, char *arg) {
+    NodeList matches = glob_matches(currentNode, arg);
+    int prefix = glob_prefix(arg);
+
+    if (!matches.count) {
+        printf("ls: cannot access '%s': No such file or directory", arg);
+        return;
+    }
+
+    for (int i = matches.count - 1; i >= 0; i--) {
+        printf("%.*s%s", prefix, arg, sdfs_name(matches.nodes[i]));
+        if (i)
+            printf("\n");
+    }
+    free(matches.nodes);
+}
+
+/*
+* If the current node is a directory, this function will proceed
+* to print the elements that this folder contains.
+*
+* In case of being a text file, this function will print its content.
+*/
+static void ls(SdfsNode *currentNode, char *arg) {
+    if (sdfs_is_pattern(arg)) {
+        ls_matching(currentNode, arg);
+        return;
+    }
+
+    NodeList children = list_children(currentNode);
+    if (!children.count)
+        return;
+
+    if (strlen(arg) == 0) {
+        print_children(&children);
+    } else {
+        SdfsNode *child, *target = NULL;
+        if (sdfs_child(currentNode, arg, &child) == SDFS_OK)
+            target = sdfs_resolve(child);
+
+        if (!target)
+            printf("ls: cannot access '%s': No such file or directory", arg);
+        else if (sdfs_type(target) == SDFS_FOLDER)
+            ls(target, "");
+        else
+            print_file(child, target);
+    }
+    free(children.nodes);
+}
+
+// This function prints the path from root to the current directory.
+static void pwd(SdfsNode *treeNode) {
+    if (!sdfs_parent(treeNode)) {
+        printf("root\n");
+        return;
+    }
+
+    size_t length;
+    sdfs_path(treeNode, NULL, 0, &length);
+    char *path = malloc(length + 1);
+    sdfs_path(treeNode, path, length + 1, NULL);
+    printf("%s", path);
+    free(path);
+}
+
+/*
+* A function used to change path from the current node, depending on the
+* argument.
+*
+* The char* path is splitted by "/" delimiter, using strtok.
+* The children are being traversed by verifying the corespondency
+* between their names and the current token.
+*
+* This function may get more options (1, 2).
+* Option 1 -> main functionality on *cd* command;
+* Option 2 -> called in *cp* and *mv* for verifying the destination node;
+*          -> if path isn't correct, it is going to return NULL.
+*/
+static SdfsNode *cd(SdfsNode *currentNode, char *path, int option) {
+    SdfsNode *initial_copy_current = currentNode, *copy = currentNode;
+
+    char *token = strtok(path, "/");
+
+    while (token != NULL) {
+        if (strcmp(token, "..") == 0) {
+            // the parent of the root is the root itself
+            if (sdfs_parent(copy))
+                copy = sdfs_parent(copy);
+        } else {
+            // a symbolic link is replaced by the node that it points to
+            SdfsNode *child, *found = NULL;
+            if (sdfs_type(copy) == SDFS_FOLDER &&
+                sdfs_child(copy, token, &child) == SDFS_OK)
+                found = sdfs_resolve(child);
+
+            if (found && sdfs_type(found) == SDFS_FOLDER) {
+                copy = found;
+            } else if (found && sdfs_type(found) != SDFS_FOLDER) {
+                if (option == 1) {
+                    printf("cd: no such file or directory: %s", path);
+                    return initial_copy_current;
+                }
+                copy = found;
+            } else {
+                if (option == 1) {
+                    printf("cd: no such file or directory: %s", path);
+                } else if (option == 2) {
+                    return NULL;
+                }
+                return initial_copy_current;
+            }
+        }
+        token = strtok(NULL, "/");
+    }
+    return copy;
+}
+
+static inline void print_indent(int distance) {
+    for (int i = 0; i < distance; i++)
+        printf("\t");
+}
+
+// The links are not followed by *tree*, but their targets are shown
+static void print_name(SdfsNode *node) {
+    if (sdfs_type(node) != SDFS_SYMLINK) {
+        printf("%s\n", sdfs_name(node));
+        return;
+    }
+
+    size_t length;
+    sdfs_readlink(node, NULL, 0, &length);
+    char *target = malloc(length + 1);
+    sdfs_readlink(node, target, length + 1, NULL);
+    printf("%s -> %s\n", sdfs_name(node), target);
+    free(target);
+}
+
+/*
+* Prints the children of a folder in reverse order, every folder being
+* followed by its own children.
+*
+* The "distance" variable represents the distance
+* between the initial parent node and the current node and
+* it is used for assign the number of tabs that needs to be printed.
+*/
+static void print_tree(SdfsNode *folder, int distance, int *nr_of_dir,
+                       int *nr_of_files) {
+    NodeList children = list_children(folder);
+
+    for (int i = children.count - 1; i >= 0; i--) {
+        SdfsNode *child = children.nodes[i];
+        print_indent(distance);
+        print_name(child);
+
+        if (sdfs_type(child) == SDFS_FOLDER) {
+            (*nr_of_dir)++;
+            print_tree(child, distance + 1, nr_of_dir, nr_of_files);
+        } else {
+            (*nr_of_files)++;
+        }
+    }
+    free(children.nodes);
+}
+
+/*
+* This function works somehow like *ls*.
+*
+* The char* path is splitted by "/" delimiter, using strtok.
+* The children are being traversed by verifying the corespondency
+* between their names and the current token.
+*/
+static void tree(SdfsNode *currentNode, char *arg) {
+    int nr_of_dir = 0, nr_of_files = 0;
+    SdfsNode *copy = currentNode;
+
+    for (char *token = strtok(arg, "/"); token; token = strtok(NULL, "/")) {
+        if (strcmp(token, "..") == 0) {
+            if (sdfs_parent(copy))
+                copy = sdfs_parent(copy);
+            continue;
+        }
+
+        SdfsNode *child, *found = NULL;
+        if (sdfs_child(copy, token, &child) == SDFS_OK)
+            found = sdfs_resolve(child);
+
+        if (!found || sdfs_type(found) != SDFS_FOLDER) {
+            printf("%s [error opening dir]\n\n0 directories, 0 files\n",
+                   arg);
+            return;
+        }
+        copy = found;
+    }
+
+    print_tree(copy, 0, &nr_of_dir, &nr_of_files);
+    printf("%d directories, %d files\n", nr_of_dir, nr_of_files);
+}
+
+/*
+* Prints the names given by the iterator, in sorted order. At most
+* "count" names are printed (a negative count prints them all).
+*
+* The names are separated by newlines, just like the ones printed by *ls*.
+*/
+static void print_sorted(SdfsIter *iter, long count) {
+    SdfsNode *node;
+    int first = 1;
+    while (count != 0 && (node = sdfs_iter_next(iter))) {
+        if (!first)
+            printf("\n");
+        printf("%s", sdfs_name(node));
+        first = 0;
+        count--;
+    }
+    sdfs_iter_close(iter);
+}
+
+/*
+* Works like *ls*, but the children are printed in alphabetical order,
+* by streaming the sorted index of the folder.
+*/
+static void ls_sorted(SdfsNode *currentNode, char *arg) {
+    // a link to a file is printed with its own name, like in *ls*
+    SdfsNode *entry = currentNode, *node = currentNode;
+    if (strlen(arg) != 0) {
+        if (sdfs_lookup(currentNode, arg, 0, &entry) != SDFS_OK)
+            entry = NULL;
+        node = sdfs_resolve(entry);
+    }
+
+    if (!node) {
+        printf("ls: cannot access '%s': No such file or directory", arg);
+        return;
+    }
+
+    SdfsIter *iter;
+    if (sdfs_type(node) == SDFS_FILE)
+        print_file(entry, node);
+    else if (sdfs_iter_open(node, NULL, &iter) == SDFS_OK)
+        print_sorted(iter, -1);
+}
+
+/*
+* Parses a non-negative number used by the paged listing. The positions
+* of the index are unsigned int, so bigger numbers are rejected instead
+* of being cut down to a smaller position.
+*/
+static int parse_count(const char *arg, long *value) {
+    char *end;
+    if (!*arg || *arg == '-')
+        return 0;
+    errno = 0;
+    *value = strtol(arg, &end, 10);
+    return *end == '\0' && errno != ERANGE &&
+           (unsigned long)*value <= UINT_MAX;
+}
+
+/*
+* Prints "count" children of a folder, in sorted order, skipping the
+* first "offset" ones. The first printed entry is found directly,
+* through the positions kept by the index.
+*/
+static void ls_page(SdfsNode *currentNode, char *arg, char *offset,
+                    char *count) {
+    long first, size;
+    if (!parse_count(offset, &first) || !parse_count(count, &size)) {
+        printf("ls: invalid page '%s %s'", offset, count);
+        return;
+    }
+
+    SdfsNode *node;
+    if (sdfs_lookup(currentNode, arg, 1, &node) != SDFS_OK) {
+        printf("ls: cannot access '%s': No such file or directory", arg);
+        return;
+    }
+
+    if (sdfs_type(node) != SDFS_FOLDER) {
+        printf("ls: cannot page '%s': Not a directory", arg);
+        return;
+    }
+
+    SdfsIter *iter;
+    if (size && sdfs_iter_at(node, first, &iter) == SDFS_OK)
+        print_sorted(iter, size);
+}
+
+/*
+* Prints the paths that complete the last component of "partial", at
+* most "count" of them (all, without a count). The folder is walked like
+* in *cd*, then the names that start with the prefix are taken in order
+* from its index, so the time depends on the matches, not on the folder.
+* The folders (and the links to folders) end with '/'.
+*/
+static void complete(SdfsNode *currentNode, char *partial, char *count) {
+    long size = -1;
+    if (strlen(count) != 0 && !parse_count(count, &size)) {
+        printf("complete: invalid count '%s'", count);
+        return;
+    }
+
+    char *slash = strrchr(partial, '/');
+    const char *prefix = slash ? slash + 1 : partial;
+    int dir_len = slash ? slash - partial + 1 : 0;
+    SdfsNode *folder = currentNode;
+
+    if (slash && slash != partial) {
+        // the folder part is walked without the prefix
+        *slash = '\0';
+        if (sdfs_lookup(currentNode, partial, 1, &folder) != SDFS_OK)
+            folder = NULL;
+        *slash = '/';
+    }
+    if (!folder || sdfs_type(folder) != SDFS_FOLDER) {
+        printf("complete: cannot access '%.*s': Not a directory", dir_len,
+               partial);
+        return;
+    }
+
+    SdfsIter *iter;
+    SdfsNode *entry;
+    int first = 1;
+    sdfs_iter_open(folder, prefix, &iter);
+    while (size != 0 && (entry = sdfs_iter_next(iter))) {
+        SdfsNode *target = sdfs_resolve(entry);
+        if (!first)
+            printf("\n");
+        printf("%.*s%s%s", dir_len, partial, sdfs_name(entry),
+               target && sdfs_type(target) == SDFS_FOLDER ? "/" : "");
+        first = 0;
+        size--;
+    }
+    sdfs_iter_close(iter);
+}
+
+// The sorted version of *print_tree*, which streams the sorted indexes
+static void print_tree_sorted(SdfsNode *folder, int distance,
+                              int *nr_of_dir, int *nr_of_files) {
+    SdfsIter *iter;
+    SdfsNode *child;
+
+    sdfs_iter_open(folder, NULL, &iter);
+    while ((child = sdfs_iter_next(iter))) {
+        print_indent(distance);
+        print_name(child);
+
+        if (sdfs_type(child) == SDFS_FOLDER) {
+            (*nr_of_dir)++;
+            print_tree_sorted(child, distance + 1, nr_of_dir, nr_of_files);
+        } else {
+            (*nr_of_files)++;
+        }
+    }
+    sdfs_iter_close(iter);
+}
+
+static void tree_sorted(SdfsNode *currentNode, char *arg) {
+    int nr_of_dir = 0, nr_of_files = 0;
+    SdfsNode *node;
+
+    if (sdfs_lookup(currentNode, arg, 1, &node) != SDFS_OK ||
+        sdfs_type(node) != SDFS_FOLDER) {
+        printf("%s [error opening dir]\n\n0 directories, 0 files\n", arg);
+        return;
+    }
+
+    print_tree_sorted(node, 0, &nr_of_dir, &nr_of_files);
+    printf("%d directories, %d files\n", nr_of_dir, nr_of_files);
+}
+
+/*
+* Prints the size of the files from a subtree, then the state of the
+* whole content store and its deduplication ratio (the size of all the
+* files divided by the size of the texts that are really kept).
+*/
+static void du(SdfsNode *currentNode, char *arg) {
+    SdfsNode *node;
+    if (sdfs_lookup(currentNode, arg, 1, &node) != SDFS_OK) {
+        printf("du: cannot access '%s': No such file or directory", arg);
+        return;
+    }
+
+    SdfsUsage usage;
+    sdfs_usage(node, &usage);
+    printf("%s: %d files, %zu bytes (%zu bytes stored)\n",
+           strlen(arg) ? arg : ".", usage.nr_of_files, usage.logical_bytes,
+           usage.stored_bytes);
+
+    SdfsStoreStats stats;
+    sdfs_store_stats(&stats);
+    printf("store: %zu blobs, %zu bytes stored for %zu bytes of files "
+           "(dedup ratio %.2f)", stats.nr_of_blobs, stats.stored_bytes,
+           stats.logical_bytes, stats.stored_bytes ?
+           (double)stats.logical_bytes / stats.stored_bytes : 1.0);
+}
+
+// Reads a number of bytes, which may end with K, M or G
+static int parse_size(const char *arg, size_t *size) {
+    char *end;
+    unsigned long long value = strtoull(arg, &end, 10);
+
+    if (end == arg)
+        return -1;
+    if (*end == 'K' || *end == 'k')
+        value <<= 10, end++;
+    else if (*end == 'M' || *end == 'm')
+        value <<= 20, end++;
+    else if (*end == 'G' || *end == 'g')
+        value <<= 30, end++;
+    if (*end != '\0')
+        return -1;
+
+    *size = value;
+    return 0;
+}
+
+/*
+* Sets the memory budget of the file texts ("off" removes it), or only
+* prints the state of the memory when no size is given. The texts over
+* the budget are written to the spill file and read back when needed.
+*/
+static void budget(char *size) {
+    if (!strcmp(size, "off")) {
+        sdfs_set_budget(0);
+    } else if (strlen(size) != 0) {
+        size_t value;
+        if (parse_size(size, &value) < 0 || value == 0) {
+            printf("budget: invalid size '%s'", size);
+            return;
+        }
+        sdfs_set_budget(value);
+    }
+
+    SdfsStoreStats stats;
+    sdfs_store_stats(&stats);
+    if (stats.budget)
+        printf("budget: %zu bytes", stats.budget);
+    else
+        printf("budget: off");
+    printf(", %zu bytes in memory, %zu of %zu blobs spilled (spill file: "
+           "%zu bytes), %zu evictions, %zu faults", stats.resident_bytes,
+           stats.nr_of_spilled, stats.nr_of_blobs, stats.spill_bytes,
+           stats.nr_of_evictions, stats.nr_of_faults);
+}
+
+/*
+* Sets the size from which the texts are compressed ("off" stops it), or
+* only prints how much the compressed texts take, without a size.
+*/
+static void compress(char *minSize) {
+    if (!strcmp(minSize, "off")) {
+        sdfs_set_compression(0);
+    } else if (strlen(minSize) != 0) {
+        size_t value;
+        if (parse_size(minSize, &value) < 0 || value == 0) {
+            printf("compress: invalid size '%s'", minSize);
+            return;
+        }
+        sdfs_set_compression(value);
+    }
+
+    SdfsStoreStats stats;
+    sdfs_store_stats(&stats);
+    if (stats.compress_min)
+        printf("compress: texts of at least %zu bytes", stats.compress_min);
+    else
+        printf("compress: off");
+    printf(", %zu blobs compressed (%zu bytes for %zu bytes, ratio %.2f), "
+           "%zu decodes in %.2f ms", stats.nr_of_packed, stats.packed_bytes,
+           stats.unpacked_bytes, stats.packed_bytes ?
+           (double)stats.unpacked_bytes / stats.packed_bytes : 1.0,
+           stats.nr_of_decodes, stats.decode_ms);
+}
+
+static int collect_match(SdfsNode *node, int depth, void *arg) {
+    SearchMatches *matches = arg;
+
+    if (matches->count == matches->size) {
+        matches->size = matches->size ? 2 * matches->size : 16;
+        matches->items = realloc(matches->items,
+                                 matches->size * sizeof(SearchMatch));
+    }
+    matches->items[matches->count].node = node;
+    matches->items[matches->count++].depth = depth;
+    return 0;
+}
+
+// Prints the path of the node, relative to the folder "depth" levels up
+static void print_relative(SdfsNode *node, int depth) {
+    if (depth > 0) {
+        print_relative(sdfs_parent(node), depth - 1);
+        printf("/");
+    }
+    printf("%s", sdfs_name(node));
+}
+
+/*
+* Prints the files from "arg" (or from the current folder) whose text
+* contains the word, then the state of the index.
+*/
+static void search(SdfsNode *currentNode, char *term, char *arg) {
+    SearchMatches matches = {.items = NULL, .count = 0, .size = 0};
+    SdfsSearchStats stats;
+
+    SdfsStatus status = sdfs_search(currentNode, arg, term, collect_match,
+                                    &matches, &stats);
+    if (status == SDFS_INVALID && strlen(term) != 0) {
+        printf("search: '%s' is not a single word", term);
+        return;
+    }
+    if (status == SDFS_INVALID) {
+        printf("search: missing word");
+        return;
+    }
+    if (status != SDFS_OK && status != SDFS_IO) {
+        printf("search: cannot access '%s': Not a directory", arg);
+        return;
+    }
+
+    if (stats.index_built)
+        printf("search: index built for %zu files in %.2f ms\n",
+               stats.nr_of_files, stats.build_ms);
+    for (size_t i = 0; i < matches.count; i++) {
+        print_relative(matches.items[i].node, matches.items[i].depth);
+        printf("\n");
+    }
+    free(matches.items);
+
+    printf("search: %zu files in %.2f ms (index: %zu files, %zu words, "
+           "%zu postings, %zu bytes)", stats.nr_of_matches, stats.search_ms,
+           stats.nr_of_files, stats.nr_of_words, stats.nr_of_postings,
+           stats.memory);
+    if (status == SDFS_IO)
+        printf("\nsearch: some files could not be read: %s",
+               sdfs_strerror(status));
+}
+
+// Prints the message that the command gives for a single target
+static void report(SdfsOp op, SdfsStatus status, const char *path) {
+    if (op == SDFS_MKDIR) {
+        begin_message();
+        printf("mkdir: cannot create directory '%s': %s", path,
+               sdfs_strerror(status));
+    } else if (op == SDFS_TOUCH) {
+        // an existing file is not an error for *touch*
+        if (status == SDFS_EXISTS)
+            return;
+        begin_message();
+        printf("touch: cannot touch '%s': %s", path, sdfs_strerror(status));
+    } else if (op == SDFS_RM && status == SDFS_IS_DIR) {
+        printf("rm: cannot remove '%s': Is a directory\n", path);
+    } else {
+        printf("%s: failed to remove '%s': %s\n",
+               op == SDFS_RM ? "rm" : op == SDFS_RMDIR ? "rmdir" : "rmrec",
+               path, sdfs_strerror(status));
+    }
+}
+
+/*
+* The targets are given to the library all at once, which walks every
+* parent folder only once; the errors are printed at the end, in the
+* order of the targets.
+*/
+static void run_batch(SdfsNode *currentNode, char **paths, int count,
+                      SdfsOp op, const char *text) {
+    SdfsStatus *statuses = malloc(count * sizeof(SdfsStatus));
+
+    sdfs_batch(currentNode, op, (const char *const *)paths, count, text,
+               text ? strlen(text) : 0, statuses);
+    for (int i = 0; i < count; i++) {
+        if (statuses[i] != SDFS_OK)
+            report(op, statuses[i], paths[i]);
+    }
+    free(statuses);
+}
+
+static void report_removal(const char *name, SdfsStatus status, void *arg) {
+    RemoveReport *removal = arg;
+
+    if (status == SDFS_IS_DIR)
+        printf("rm: cannot remove '%.*s%s': Is a directory\n",
+               removal->prefix, removal->arg, name);
+    else if (status != SDFS_OK)
+        printf("%s: failed to remove '%.*s%s': %s\n", removal->command,
+               removal->prefix, removal->arg, name, sdfs_strerror(status));
+}
+
+/*
+* Removes the children that match the pattern. Without "recursive",
+* directories are reported and kept, just like *rm* does.
+*/
+static void remove_matching(SdfsNode *currentNode, char *arg,
+                            int recursive) {
+    RemoveReport removal = {.command = recursive ? "rmrec" : "rm",
+                            .arg = arg, .prefix = glob_prefix(arg)};
+
+    if (sdfs_rm_glob(currentNode, arg, recursive, report_removal,
+                     &removal) == SDFS_NO_ENTRY)
+        printf("%s: failed to remove '%s': No such file or directory\n",
+               removal.command, arg);
+}
+
+static void remove_one(SdfsNode *currentNode, char *name, SdfsOp op) {
+    if (sdfs_is_pattern(name))
+        remove_matching(currentNode, name, op == SDFS_RMREC);
+    else
+        run_batch(currentNode, &name, 1, op, NULL);
+}
+
+/*
+* The removals with patterns are done one by one, as every pattern is
+* already handled in a single pass over its folder.
+*/
+static void remove_many(SdfsNode *currentNode, char **names, int count,
+                        SdfsOp op) {
+    for (int i = 0; i < count; i++) {
+        if (!sdfs_is_pattern(names[i]))
+            continue;
+
+        for (i = 0; i < count; i++)
+            remove_one(currentNode, names[i], op);
+        return;
+    }
+    run_batch(currentNode, names, count, op, NULL);
+}
+
+/*
+* Copies one source into dest_node, which was already resolved from
+* "destination" (it is NULL if the destination does not exist).
+*/
+static void copy_path(SdfsNode *currentNode, char *source,
+                      SdfsNode *dest_node, char *destination) {
+    // a link given as the source is copied as the file that it points to
+    SdfsNode *source_node;
+    if (sdfs_lookup(currentNode, source, 1, &source_node) != SDFS_OK) {
+        begin_message();
+        printf("cp: cannot stat '%s': No such file or directory", source);
+    } else if (sdfs_type(source_node) == SDFS_FOLDER) {
+        begin_message();
+        printf("cp: -r not specified; omitting directory '%s'", source);
+    } else if (!dest_node) {
+        begin_message();
+        printf("cp: failed to access '%s': Not a directory", destination);
+    } else if (sdfs_copy_into(source_node, dest_node) != SDFS_OK) {
+        begin_message();
+        printf("cp: cannot overwrite directory '%s' with non-directory",
+               destination);
+    }
+}
+
+/*
+* The glob version of *cp*. The destination is resolved only once and
+* every matched file is copied into it.
+*/
+static void cp_matching(SdfsNode *currentNode, char *source,
+                        char *destination) {
+    NodeList matches = glob_matches(currentNode, source);
+    int prefix = glob_prefix(source);
+
+    if (!matches.count) {
+        begin_message();
+        printf("cp: cannot stat '%s': No such file or directory", source);
+        return;
+    }
+
+    SdfsNode *dest_node;
+    if (sdfs_lookup(currentNode, destination, 1, &dest_node) != SDFS_OK) {
+        begin_message();
+        printf("cp: failed to access '%s': Not a directory", destination);
+    } else if (matches.count > 1 && sdfs_type(dest_node) != SDFS_FOLDER) {
+        begin_message();
+        printf("cp: target '%s' is not a directory", destination);
+    } else {
+        for (int i = 0; i < matches.count; i++) {
+            const char *name = sdfs_name(matches.nodes[i]);
+            SdfsNode *match = sdfs_resolve(matches.nodes[i]);
+            if (!match) {
+                begin_message();
+                printf("cp: cannot stat '%.*s%s': No such file or directory",
+                       prefix, source, name);
+            } else if (sdfs_type(match) == SDFS_FOLDER) {
+                begin_message();
+                printf("cp: -r not specified; omitting directory '%.*s%s'",
+                       prefix, source, name);
+            } else if (sdfs_copy_into(match, dest_node) != SDFS_OK) {
+                begin_message();
+                printf("cp: cannot overwrite directory '%s' with "
+                       "non-directory", destination);
+            }
+        }
+    }
+    free(matches.nodes);
+}
+
+/*
+* Function used to copy files from src to dest.
+*
+* The copy is a new node, independent from the source, but its text is
+* shared through the content store, so it costs just one reference.
+*/
+static void cp(SdfsNode *currentNode, char *source, char *destination) {
+    if (sdfs_is_pattern(source)) {
+        cp_matching(currentNode, source, destination);
+        return;
+    }
+
+    char *copy_dest = strdup(destination);
+    SdfsNode *dest_node = cd(currentNode, destination, 2);
+    copy_path(currentNode, source, dest_node, copy_dest);
+    free(copy_dest);
 }
 
-TreeNode* process_command(TreeNode* currentFolder,
-        char cmd[3][TOKEN_MAX_LEN], int token_count) {
-    execute_command(cmd[0], cmd[1], cmd[2]);
+/*
+* Copies many sources (the last argument is the destination, which has
+* to be a directory). The destination is resolved only once.
+*/
+static void cp_many(SdfsNode *currentNode, char **sources, int count,
+                    char *destination) {
+    SdfsNode *dest_node;
+    if (sdfs_lookup(currentNode, destination, 1, &dest_node) != SDFS_OK)
+        dest_node = NULL;
+    if (dest_node && sdfs_type(dest_node) != SDFS_FOLDER) {
+        begin_message();
+        printf("cp: target '%s' is not a directory", destination);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (sdfs_is_pattern(sources[i]))
+            cp_matching(currentNode, sources[i], destination);
+        else
+            copy_path(currentNode, sources[i], dest_node, destination);
+    }
+}
+
+/*
+* Moves one source into dest_node, which was already resolved from
+* "destination" (it is NULL if the destination does not exist).
+*/
+static void move_path(SdfsNode *currentNode, char *source,
+                      SdfsNode *dest_node, char *destination) {
+    // a link is moved itself, not the node that it points to
+    SdfsNode *source_node;
+    SdfsStatus status = SDFS_OK;
+
+    if (sdfs_lookup(currentNode, source, 0, &source_node) != SDFS_OK ||
+        !sdfs_parent(source_node)) {
+        begin_message();
+        printf("mv: failed to access '%s': Not a directory", source);
+    } else if (!dest_node) {
+        begin_message();
+        printf("mv: failed to access '%s': Not a directory", destination);
+    } else {
+        status = sdfs_move_into(source_node, dest_node);
+    }
+
+    if (status == SDFS_INVALID) {
+        begin_message();
+        printf("mv: cannot move '%s' to a subdirectory of itself, '%s'",
+               source, destination);
+    } else if (status == SDFS_NOT_EMPTY) {
+        begin_message();
+        printf("mv: cannot move '%s' to '%s': Directory not empty",
+               source, destination);
+    }
+}
+
+/*
+* The glob version of *mv*. The matches are collected before moving
+* them, as the destination may be the same folder.
+*/
+static void mv_matching(SdfsNode *currentNode, char *source,
+                        char *destination) {
+    NodeList matches = glob_matches(currentNode, source);
+    int prefix = glob_prefix(source);
+
+    if (!matches.count) {
+        begin_message();
+        printf("mv: cannot stat '%s': No such file or directory", source);
+        return;
+    }
+
+    SdfsNode *dest_node;
+    if (sdfs_lookup(currentNode, destination, 1, &dest_node) != SDFS_OK) {
+        begin_message();
+        printf("mv: failed to access '%s': Not a directory", destination);
+    } else if (matches.count > 1 && sdfs_type(dest_node) != SDFS_FOLDER) {
+        begin_message();
+        printf("mv: target '%s' is not a directory", destination);
+    } else {
+        for (int i = 0; i < matches.count; i++) {
+            const char *name = sdfs_name(matches.nodes[i]);
+            SdfsStatus status = sdfs_move_into(matches.nodes[i], dest_node);
+            if (status == SDFS_INVALID) {
+                begin_message();
+                printf("mv: cannot move '%.*s%s' to a subdirectory of "
+                       "itself, '%s'", prefix, source, name, destination);
+            } else if (status == SDFS_NOT_EMPTY) {
+                begin_message();
+                printf("mv: cannot move '%.*s%s' to '%s': Directory not "
+                       "empty", prefix, source, name, destination);
+            }
+        }
+    }
+    free(matches.nodes);
+}
+
+/*
+* If the *cp* function is copying raw data, this *mv* function
+* is just working with pointers, as the node that needs to be
+* removed from a directory is going to change its parent to
+* the destination.
+*/
+static void mv(SdfsNode *currentNode, char *source, char *destination) {
+    if (sdfs_is_pattern(source)) {
+        mv_matching(currentNode, source, destination);
+        return;
+    }
+
+    char *copy_dest = strdup(destination);
+    SdfsNode *dest_node = cd(currentNode, destination, 2);
+    move_path(currentNode, source, dest_node, copy_dest);
+    free(copy_dest);
+}
+
+/*
+* Moves many sources into a directory (the last argument). The
+* destination is resolved only once.
+*/
+static void mv_many(SdfsNode *currentNode, char **sources, int count,
+                    char *destination) {
+    SdfsNode *dest_node;
+    if (sdfs_lookup(currentNode, destination, 1, &dest_node) != SDFS_OK)
+        dest_node = NULL;
+    if (dest_node && sdfs_type(dest_node) != SDFS_FOLDER) {
+        begin_message();
+        printf("mv: target '%s' is not a directory", destination);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (sdfs_is_pattern(sources[i]))
+            mv_matching(currentNode, sources[i], destination);
+        else
+            move_path(currentNode, sources[i], dest_node, destination);
+    }
+}
+
+/*
+* A missing entry is either the target of a hard link or the folder of
+* the link; nothing was changed, so the target is looked up again.
+*/
+static void ln(SdfsNode *currentNode, char *target, char *linkName,
+               int symbolic) {
+    const char *kind = symbolic ? "symbolic" : "hard";
+    SdfsStatus status = sdfs_ln(currentNode, target, linkName, symbolic);
+    SdfsNode *target_node;
+
+    if (status == SDFS_INVALID)
+        printf("ln: missing file operand");
+    else if (status == SDFS_NO_ENTRY && !symbolic &&
+             sdfs_lookup(currentNode, target, 1, &target_node) != SDFS_OK)
+        printf("ln: failed to access '%s': No such file or directory",
+               target);
+    else if (status == SDFS_IS_DIR)
+        printf("ln: '%s': hard link not allowed for directory", target);
+    else if (status == SDFS_NO_ENTRY)
+        printf("ln: failed to create %s link '%s': No such file or directory",
+               kind, linkName);
+    else if (status == SDFS_EXISTS)
+        printf("ln: failed to create %s link '%s': File exists", kind,
+               linkName);
+}
+
+/*
+* The name that *import* gives to the host path: its last component,
+* without trailing '/', or the real name of the directory for "." and
+* "..".
+*/
+static char *host_name(const char *hostPath) {
+    size_t end = strlen(hostPath), start;
+
+    while (end > 1 && hostPath[end - 1] == '/')
+        end--;
+    start = end;
+    while (start > 0 && hostPath[start - 1] != '/')
+        start--;
+    if ((end - start == 1 && hostPath[start] == '.') ||
+        (end - start == 2 && !strncmp(hostPath + start, "..", 2))) {
+        // a real path has no "." or ".." left
+        char *real = realpath(hostPath, NULL), *name;
+        if (real) {
+            name = host_name(real);
+            free(real);
+            return name;
+        }
+    }
+    return strndup(hostPath + start, end - start);
+}
+
+/*
+* Copies a directory (or a file) of the host file system into the
+* destination folder, under the last component of the host path.
+*/
+static void import(SdfsNode *currentNode, char *hostPath, char *destination) {
+    SdfsNode *dest_node;
+    if (sdfs_lookup(currentNode, destination, 1, &dest_node) != SDFS_OK ||
+        sdfs_type(dest_node) != SDFS_FOLDER) {
+        printf("import: failed to access '%s': Not a directory", destination);
+        return;
+    }
+
+    SdfsHostStats stats;
+    SdfsStatus status = sdfs_import(dest_node, hostPath, &stats);
+
+    if (status == SDFS_NO_ENTRY) {
+        printf("import: cannot stat '%s': No such file or directory",
+               hostPath);
+    } else if (status == SDFS_INVALID) {
+        printf("import: cannot import '%s': Invalid name", hostPath);
+    } else if (status == SDFS_EXISTS) {
+        char *name = host_name(hostPath);
+        printf("import: cannot create '%s': File exists", name);
+        free(name);
+    } else if (status == SDFS_IO) {
+        printf("import: cannot read '%s'", hostPath);
+    } else if (status == SDFS_UNSUPPORTED) {
+        printf("import: cannot import '%s': Not a file or directory",
+               hostPath);
+    } else {
+        printf("import: %d directories, %d files", stats.nr_of_dir,
+               stats.nr_of_files);
+        if (stats.nr_of_links)
+            printf(", %d links", stats.nr_of_links);
+        if (stats.nr_skipped)
+            printf(", %d skipped", stats.nr_skipped);
+    }
+}
+
+static inline int is_archive(const char *path) {
+    size_t len = strlen(path), suffix_len = strlen(TAR_SUFFIX);
+    return len > suffix_len && !strcmp(path + len - suffix_len, TAR_SUFFIX);
+}
+
+/*
+* Writes a subtree outside of the simulated file system.
+*
+* If the destination ends with ".tar", a POSIX archive is written, with
+* the subtree placed under its own name. Otherwise, the destination has
+* to be an existing host directory, where the subtree is recreated.
+*/
+static void export(SdfsNode *currentNode, char *source, char *destination) {
+    SdfsNode *source_node;
+    if (sdfs_lookup(currentNode, source, 1, &source_node) != SDFS_OK) {
+        printf("export: cannot access '%s': No such file or directory",
+               source);
+        return;
+    }
+
+    SdfsHostStats stats;
+    SdfsStatus status;
+
+    if (is_archive(destination)) {
+        int fd = open(destination, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            printf("export: cannot create '%s'", destination);
+            return;
+        }
+        status = sdfs_export_archive(source_node, fd, &stats);
+        close(fd);
+    } else {
+        int dir_fd = open(destination, O_RDONLY | O_DIRECTORY);
+        if (dir_fd < 0) {
+            printf("export: cannot access '%s': Not a directory",
+                   destination);
+            return;
+        }
+        status = sdfs_export_dir(source_node, dir_fd, &stats);
+        close(dir_fd);
+    }
+
+    if (status != SDFS_OK) {
+        printf("export: failed to write '%s': %s", destination,
+               strerror(errno));
+        return;
+    }
+    printf("export: %d directories, %d files, %zu bytes", stats.nr_of_dir,
+           stats.nr_of_files, stats.nr_of_bytes);
+}
+
+/*
+* *begin* starts recording the changes of mkdir, touch, rm, rmdir, rmrec,
+* cp and mv (and of the other commands that add nodes), until *commit*
+* keeps them or *abort* reverses them.
+*/
+static void begin_transaction(void) {
+    if (sdfs_begin() != SDFS_OK)
+        printf("begin: a transaction is already in progress");
+}
+
+static SdfsNode *commit_transaction(SdfsNode *currentNode) {
+    size_t nr_of_records;
+
+    if (sdfs_commit(&currentNode, &nr_of_records) != SDFS_OK) {
+        printf("commit: no transaction in progress");
+        return currentNode;
+    }
+    printf("commit: %zu changes", nr_of_records);
+    return currentNode;
+}
+
+static SdfsNode *abort_transaction(SdfsNode *currentNode) {
+    size_t nr_of_records;
+
+    if (sdfs_abort(&currentNode, &nr_of_records) != SDFS_OK) {
+        printf("abort: no transaction in progress");
+        return currentNode;
+    }
+    printf("abort: %zu changes rolled back", nr_of_records);
+    return currentNode;
+}
+
+static void print_report(const SdfsReport *report, void *arg) {
+    (void)arg;
+
+    if (report->type == SDFS_REPORT_PROGRESS) {
+        printf("checkpoint: %zu%% (%zu of %zu nodes, %.2f ms)\n",
+               100 * report->nr_of_nodes / report->total,
+               report->nr_of_nodes, report->total, report->elapsed_ms);
+    } else if (report->type == SDFS_REPORT_DONE) {
+        printf("checkpoint: wrote '%s' (%d directories, %d files, "
+               "%zu bytes) in %.2f ms\n", report->path,
+               report->stats.nr_of_dir, report->stats.nr_of_files,
+               report->stats.nr_of_bytes, report->elapsed_ms);
+    } else {
+        printf("checkpoint: failed to write '%s': %s\n", report->path,
+               report->error ? strerror(report->error)
+                             : "child process died");
+    }
+}
+
+/*
+* Writes the whole tree to a tar archive, without stopping the commands.
+* Only fork() is waited for; the reports of the child are printed between
+* the next commands.
+*/
+static void checkpoint(SdfsNode *currentNode, char *path) {
+    if (sdfs_checkpoint_path()) {
+        printf("checkpoint: '%s' is still being written",
+               sdfs_checkpoint_path());
+        return;
+    }
+
+    // the buffered output would be printed by both processes otherwise
+    fflush(stdout);
+
+    double stall;
+    SdfsStatus status = sdfs_checkpoint(currentNode, path, &stall);
+    if (status == SDFS_BUSY)
+        printf("checkpoint: not allowed during a transaction");
+    else if (status != SDFS_OK)
+        printf("checkpoint: %s", strerror(errno));
+    else
+        printf("checkpoint: writing '%s' in the background (fork: %.2f ms)",
+               sdfs_checkpoint_path(), stall);
+}
+
+// Prints the events of one watch that concern its node or its children
+static void print_events(Watcher *watcher) {
+    SdfsEvent events[WATCH_BATCH];
+    unsigned long long lost = 0, reported = 0;
+    size_t count, shown = 0;
+
+    while ((count = sdfs_watch_read(watcher->watch, events, WATCH_BATCH,
+                                    &lost)) > 0) {
+        // the lost events come before the ones of the batch
+        if (lost > reported) {
+            begin_message();
+            printf("%d: %llu events lost", watcher->id, lost - reported);
+            reported = lost;
+            shown++;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (events[i].node_id != watcher->node_id &&
+                events[i].parent_id != watcher->node_id)
+                continue;
+            begin_message();
+            printf("%d: %s '%s' (node %u, parent %u)", watcher->id,
+                   event_names[events[i].type], events[i].name,
+                   events[i].node_id, events[i].parent_id);
+            shown++;
+        }
+    }
+    if (!shown) {
+        begin_message();
+        printf("%d: no events", watcher->id);
+    }
+}
+
+/*
+* With a path, starts watching the folder (or file): the changes of the
+* node and of its children are reported. Without a path, prints the
+* events of every watch since the last call.
+*/
+static void watch(SdfsNode *currentNode, char *path) {
+    if (strlen(path) == 0) {
+        if (!watchers)
+            printf("watch: no watches");
+        for (Watcher *watcher = watchers; watcher; watcher = watcher->next)
+            print_events(watcher);
+        return;
+    }
+
+    SdfsNode *node;
+    if (sdfs_lookup(currentNode, path, 1, &node) != SDFS_OK) {
+        printf("watch: cannot access '%s': No such file or directory",
+               path);
+        return;
+    }
+
+    Watcher *watcher = malloc(sizeof(Watcher));
+    watcher->id = ++last_watcher_id;
+    watcher->node_id = sdfs_id(node);
+    watcher->path = strdup(path);
+    watcher->watch = sdfs_watch_open();
+
+    // the watches are kept in the order they were added
+    Watcher **last = &watchers;
+    while (*last)
+        last = &(*last)->next;
+    watcher->next = NULL;
+    *last = watcher;
+
+    printf("watch: %d: watching '%s'", watcher->id, path);
+}
+
+static void unwatch(char *id) {
+    int watcher_id = atoi(id);
+    Watcher **link = &watchers;
+
+    while (*link && (*link)->id != watcher_id)
+        link = &(*link)->next;
+    if (!*link) {
+        printf("unwatch: no watch '%s'", id);
+        return;
+    }
+
+    Watcher *watcher = *link;
+    *link = watcher->next;
+    sdfs_watch_close(watcher->watch);
+    free(watcher->path);
+    free(watcher);
+}
+
+void execute_command(char** cmd, int token_count) {
+    printf("$ %s %s %s", cmd[0], cmd[1], cmd[2]);
+    for (int i = 3; i < token_count; i++)
+        printf(" %s", cmd[i]);
+    printf("\n");
+}
+
+SdfsNode* process_command(SdfsNode* currentFolder, char** cmd,
+        int token_count) {
+    // the commands that create or remove nodes take many targets
+    int nr_of_args = token_count > 1 ? token_count - 1 : 1;
+
+    execute_command(cmd, token_count);
+    reset_messages();
     if (!strcmp(cmd[0], LS)) {
-        ls(currentFolder, cmd[1]);
+        if (!strcmp(cmd[1], SORTED))
+            ls_sorted(currentFolder, cmd[2]);
+        else if (token_count == 4)
+            ls_page(currentFolder, cmd[1], cmd[2], cmd[3]);
+        else
+            ls(currentFolder, cmd[1]);
+    } else if (!strcmp(cmd[0], COMPLETE)) {
+        complete(currentFolder, cmd[1], cmd[2]);
     } else if (!strcmp(cmd[0], PWD)) {
         pwd(currentFolder);
     } else if (!strcmp(cmd[0], TREE)) {
-        tree(currentFolder, cmd[1]);
+        if (!strcmp(cmd[1], SORTED))
+            tree_sorted(currentFolder, cmd[2]);
+        else
+            tree(currentFolder, cmd[1]);
+    } else if (!strcmp(cmd[0], DU)) {
+        du(currentFolder, cmd[1]);
+    } else if (!strcmp(cmd[0], BUDGET)) {
+        budget(cmd[1]);
+    } else if (!strcmp(cmd[0], COMPRESS)) {
+        compress(cmd[1]);
+    } else if (!strcmp(cmd[0], SEARCH)) {
+        search(currentFolder, cmd[1], cmd[2]);
     } else if (!strcmp(cmd[0], CD)) {
         currentFolder = cd(currentFolder, cmd[1], 1);
     } else if (!strcmp(cmd[0], MKDIR)) {
-        mkdir(currentFolder, cmd[1]);
+        run_batch(currentFolder, cmd + 1, nr_of_args, SDFS_MKDIR, NULL);
     } else if (!strcmp(cmd[0], RMDIR)) {
-        rmdir(currentFolder, cmd[1]);
+        run_batch(currentFolder, cmd + 1, nr_of_args, SDFS_RMDIR, NULL);
     } else if (!strcmp(cmd[0], RM)) {
-        rm(currentFolder, cmd[1]);
+        remove_many(currentFolder, cmd + 1, nr_of_args, SDFS_RM);
     } else if (!strcmp(cmd[0], RMREC)) {
-        rmrec(currentFolder, cmd[1]);
+        remove_many(currentFolder, cmd + 1, nr_of_args, SDFS_RMREC);
     } else if (!strcmp(cmd[0], TOUCH)) {
-        touch(currentFolder, cmd[1], cmd[2]);
+        if (!strcmp(cmd[1], EMPTY_FILES) && token_count > 2)
+            run_batch(currentFolder, cmd + 2, token_count - 2, SDFS_TOUCH,
+                      "");
+        else
+            run_batch(currentFolder, cmd + 1, 1, SDFS_TOUCH, cmd[2]);
     } else if (!strcmp(cmd[0], MV)) {
-        mv(currentFolder, cmd[1], cmd[2]);
+        if (token_count > 3)
+            mv_many(currentFolder, cmd + 1, token_count - 2,
+                    cmd[token_count - 1]);
+        else
+            mv(currentFolder, cmd[1], cmd[2]);
     } else if (!strcmp(cmd[0], CP)) {
-        cp(currentFolder, cmd[1], cmd[2]);
+        if (token_count > 3)
+            cp_many(currentFolder, cmd + 1, token_count - 2,
+                    cmd[token_count - 1]);
+        else
+            cp(currentFolder, cmd[1], cmd[2]);
+    } else if (!strcmp(cmd[0], LN)) {
+        if (!strcmp(cmd[1], SYMBOLIC))
+            ln(currentFolder, cmd[2], cmd[3], 1);
+        else
+            ln(currentFolder, cmd[1], cmd[2], 0);
+    } else if (!strcmp(cmd[0], IMPORT)) {
+        import(currentFolder, cmd[1], cmd[2]);
+    } else if (!strcmp(cmd[0], EXPORT)) {
+        export(currentFolder, cmd[1], cmd[2]);
+    } else if (!strcmp(cmd[0], BEGIN)) {
+        begin_transaction();
+    } else if (!strcmp(cmd[0], COMMIT)) {
+        currentFolder = commit_transaction(currentFolder);
+    } else if (!strcmp(cmd[0], ABORT)) {
+        currentFolder = abort_transaction(currentFolder);
+    } else if (!strcmp(cmd[0], CHECKPOINT)) {
+        checkpoint(currentFolder, cmd[1]);
+    } else if (!strcmp(cmd[0], WATCH)) {
+        watch(currentFolder, cmd[1]);
+    } else if (!strcmp(cmd[0], UNWATCH)) {
+        unwatch(cmd[1]);
     } else {
         printf("UNRECOGNIZED COMMAND!\n");
     }
@@ -53,30 +1430,46 @@ TreeNode* process_command(TreeNode* currentFolder,
 }
 
 int main() {
-    char line[LINE_MAX_LEN];
-    char cmd[3][TOKEN_MAX_LEN];
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t line_len;
+    char **cmd = malloc(MIN_TOKENS * sizeof(char *));
+    int max_tokens = MIN_TOKENS;
     char *token;
 
-    FileTree fileTree = createFileTree("root");
-    TreeNode* currentFolder = fileTree.root;
-
-    while (fgets(line, sizeof(line), stdin) != NULL) {
-        line[strlen(line)-1] = '\0';
+    SdfsTree *fileTree = sdfs_open();
+    SdfsNode* currentFolder = sdfs_root(fileTree);
 
-        cmd[0][0] = cmd[1][0] = cmd[2][0] = 0;
+    // the tokens point inside the line, which may have any length
+    while ((line_len = getline(&line, &line_size, stdin)) != -1) {
+        if (line_len && line[line_len - 1] == '\n')
+            line[line_len - 1] = '\0';
 
         int token_idx = 0;
         token = strtok(line, " ");
         while (token) {
-            strcpy(cmd[token_idx], token);
-            ++token_idx;
+            if (token_idx == max_tokens) {
+                max_tokens *= 2;
+                cmd = realloc(cmd, max_tokens * sizeof(char *));
+            }
+            cmd[token_idx++] = token;
 
             token = strtok(NULL, " ");
         }
+        for (int i = token_idx; i < MIN_TOKENS; i++)
+            cmd[i] = "";
+
+        // the reports of a background checkpoint come between commands
+        sdfs_checkpoint_poll(0, print_report, NULL);
         currentFolder = process_command(currentFolder, cmd, token_idx);
     }
 
-    freeTree(fileTree);
+    sdfs_checkpoint_poll(1, print_report, NULL);
+
+    free(cmd);
+    free(line);
+    // a transaction that was not committed is rolled back
+    sdfs_close(fileTree);
 
     return 0;
 }
@@ -0,0 +1,135 @@
+#ifndef NODE_H
+#define NODE_H
+
+#include "store.h"
+
+#define TREE_CMD_INDENT_SIZE 4
+#define NO_ARG ""
+#define PARENT_DIR ".."
+#define LINK_MAX_HOPS 40
+
+// the operations that create or remove one node for every target
+#define BATCH_MKDIR 0
+#define BATCH_TOUCH 1
+#define BATCH_RM 2
+#define BATCH_RMDIR 3
+#define BATCH_RMREC 4
+
+/*
+* The outcome of an operation on one target. The commands turn it into
+* their own message, the library API returns it to the caller.
+*/
+#define STATUS_OK 0
+#define STATUS_EXISTS 1
+#define STATUS_NO_ENTRY 2
+#define STATUS_NOT_DIR 3
+#define STATUS_IS_DIR 4
+#define STATUS_NOT_EMPTY 5
+#define STATUS_INVALID 6    // a missing operand, or a move into itself
+#define STATUS_NO_TARGET 7  // the target of a hard link does not exist
+#define STATUS_BUSY 8       // the node holds the current folder
+#define STATUS_IO 9         // the host file system failed (see errno)
+#define STATUS_UNSUPPORTED 10  // a host entry that is not a file or folder
+
+typedef struct FileContent FileContent;
+typedef struct LinkContent LinkContent;
+typedef struct FolderContent FolderContent;
+typedef struct TreeNode TreeNode;
+typedef struct FileTree FileTree;
+typedef struct ListNode ListNode;
+typedef struct List List;
+typedef struct NameIndex NameIndex;
+
+enum TreeNodeType {
+    FILE_NODE,
+    FOLDER_NODE,
+    SYMLINK_NODE
+};
+
+/*
+* The hard links of a file share the same FileContent. "nodes" is only
+* allocated when the second link is created.
+*/
+struct FileContent {
+    Blob* body;  // shared with the files that have the same text
+    unsigned int links;
+    TreeNode** nodes;
+};
+
+/*
+* The target of a symbolic link is a path relative to the folder of the
+* link. The node that it resolves to is cached until the tree changes.
+*/
+struct LinkContent {
+    char* target;
+    TreeNode* cache;
+    int hops;  // the links followed to reach "cache"
+    unsigned long version;
+};
+
+struct FolderContent {
+    List* children;
+    NameIndex* index;  // sorted view of children, built on first use
+};
+
+struct TreeNode {
+    TreeNode* parent;
+    unsigned int id;  // unique for every node that was ever created
+    char* name;
+    enum TreeNodeType type;
+    void* content;
+};
+
+struct FileTree {
+    TreeNode* root;
+};
+
+struct ListNode {
+    TreeNode* info;
+    ListNode* next;
+};
+
+struct List {
+    ListNode* head;
+    ListNode* tail;  // the last child, so new children are added directly
+};
+
+// helpers shared by the modules that build or change the tree
+TreeNode* new_node(const char* name, enum TreeNodeType type, void* content);
+FileContent* new_file_content(Blob* body);
+LinkContent* new_link_content(const char* target);
+void append_child(TreeNode* folder, TreeNode* node);
+void link_child(TreeNode* folder, ListNode* prev, ListNode* child);
+void detach_child(TreeNode* folder, ListNode* prev, ListNode* child);
+ListNode* find_child(TreeNode* folder, const char* name, ListNode** prev);
+TreeNode* walk_path(TreeNode* currentNode, const char* path);
+TreeNode* lookup_path(TreeNode* currentNode, const char* path, int follow);
+TreeNode* resolve_link(TreeNode* node);
+void tree_changed(void);
+void free_node(TreeNode* node);
+NameIndex* folder_index(TreeNode* folder);
+size_t node_path(const TreeNode* node, char* buffer, size_t size);
+
+// the cores of the commands, which return a STATUS_* code and print nothing
+void batch_many(TreeNode* currentNode, const char* const* paths, int count,
+                int kind, const char* text, size_t size, int* statuses);
+int batch_one(TreeNode* currentNode, const char* path, int kind,
+              const char* text, size_t size);
+int copy_into(TreeNode* source_node, TreeNode* dest_node);
+int move_into(TreeNode* source_node, TreeNode* dest_node);
+int link_path(TreeNode* currentNode, const char* target,
+              const char* linkName, int symbolic);
+void disk_usage(TreeNode* node, int* nr_of_files, size_t* logical,
+                size_t* stored);
+
+/*
+* The glob versions of the commands. Only the last component of the
+* argument may contain wildcards; the folder is NULL if it does not exist.
+*/
+typedef void (*RemoveResult)(const char* name, int status, void* arg);
+
+TreeNode** glob_collect(TreeNode* currentNode, const char* arg, int* count);
+int remove_matching(TreeNode* currentNode, const char* arg, int recursive,
+                    RemoveResult result, void* resultArg);
+
+#endif  // NODE_H
@@ -0,0 +1,144 @@
+// Copyright Avram Cristian - Stefan 2022 stefanavram93@gmail.com
+// Copyright Dumitrescu Rares - Matei 2022 mateidum828@gmail.com
+
+#include <stdlib.h>
+#include <string.h>
+#include "pattern.h"
+
+#define SET_ADD(set, c) ((set)[(unsigned char)(c) >> 3] |= \
+                         1 << ((unsigned char)(c) & 7))
+#define SET_HAS(set, c) ((set)[(unsigned char)(c) >> 3] & \
+                         (1 << ((unsigned char)(c) & 7)))
+
+// Checks if the argument has to be treated as a glob pattern
+int has_wildcards(const char *text) {
+    return strpbrk(text, "*?[") != NULL;
+}
+
+/*
+* Compiles a "[...]" group into a bitmap of 256 characters.
+* Ranges ("a-z") and negation ("[!...]" or "[^...]") are accepted.
+*
+* Returns the position after the closing bracket, or NULL if the
+* group is not closed (in that case, '[' is just a normal character).
+*/
+static const char *compile_set(const char *text, PatternStep *step) {
+    const char *p = text + 1;
+    int negate = 0;
+
+    if (*p == '!' || *p == '^') {
+        negate = 1;
+        p++;
+    }
+
+    memset(step->set, 0, sizeof(step->set));
+    // a ']' placed first is a member of the group
+    if (*p == ']') {
+        SET_ADD(step->set, ']');
+        p++;
+    }
+
+    while (*p && *p != ']') {
+        if (p[1] == '-' && p[2] && p[2] != ']') {
+            for (int c = (unsigned char)p[0]; c <= (unsigned char)p[2]; c++)
+                SET_ADD(step->set, c);
+            p += 3;
+        } else {
+            SET_ADD(step->set, *p);
+            p++;
+        }
+    }
+
+    if (*p != ']')
+        return NULL;
+
+    if (negate) {
+        for (int i = 0; i < 32; i++)
+            step->set[i] = ~step->set[i];
+    }
+    step->type = MATCH_SET;
+    return p + 1;
+}
+
+/*
+* The pattern is compiled once, into an array of steps, so matching it
+* against every child of a folder does not parse the text again.
+*/
+Pattern *pattern_compile(const char *text) {
+    Pattern *pattern = malloc(sizeof(Pattern) +
+                              strlen(text) * sizeof(PatternStep));
+    pattern->size = 0;
+
+    const char *p = text, *end;
+    while (*p) {
+        PatternStep *step = &pattern->steps[pattern->size];
+
+        if (*p == '*') {
+            // consecutive stars are the same as a single one
+            if (pattern->size == 0 || step[-1].type != MATCH_STAR) {
+                step->type = MATCH_STAR;
+                pattern->size++;
+            }
+            p++;
+            continue;
+        }
+
+        if (*p == '?') {
+            step->type = MATCH_ANY;
+            p++;
+        } else if (*p == '[' && (end = compile_set(p, step)) != NULL) {
+            p = end;
+        } else {
+            step->type = MATCH_CHAR;
+            step->ch = *p;
+            p++;
+        }
+        pattern->size++;
+    }
+    return pattern;
+}
+
+static inline int step_match(const PatternStep *step, char c) {
+    if (step->type == MATCH_ANY)
+        return 1;
+    if (step->type == MATCH_SET)
+        return SET_HAS(step->set, c) != 0;
+    return step->ch == (unsigned char)c;
+}
+
+/*
+* Matches a name against the compiled pattern.
+*
+* When a step fails after a '*', the matching goes back to the last
+* star and lets it take one more character. Only the last star has to
+* be remembered, so there is no recursion.
+*/
+int pattern_match(const Pattern *pattern, const char *name) {
+    int step = 0, star_step = -1;
+    const char *star_name = NULL;
+
+    while (*name) {
+        if (step < pattern->size &&
+            pattern->steps[step].type == MATCH_STAR) {
+            star_step = step++;
+            star_name = name;
+        } else if (step < pattern->size &&
+                   step_match(&pattern->steps[step], *name)) {
+            step++;
+            name++;
+        } else if (star_step >= 0) {
+            step = star_step + 1;
+            name = ++star_name;
+        } else {
+            return 0;
+        }
+    }
+
+    while (step < pattern->size && pattern->steps[step].type == MATCH_STAR)
+        step++;
+    return step == pattern->size;
+}
+
+void pattern_free(Pattern *pattern) {
+    free(pattern);
+}
@@ -0,0 +1,30 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+typedef struct PatternStep PatternStep;
+typedef struct Pattern Pattern;
+
+enum PatternStepType {
+    MATCH_CHAR,  // one exact character
+    MATCH_ANY,   // '?'
+    MATCH_STAR,  // '*'
+    MATCH_SET    // '[...]'
+};
+
+struct PatternStep {
+    enum PatternStepType type;
+    unsigned char ch;
+    unsigned char set[32];  // bitmap of the accepted characters
+};
+
+struct Pattern {
+    int size;
+    PatternStep steps[];
+};
+
+int has_wildcards(const char* text);
+Pattern* pattern_compile(const char* text);
+int pattern_match(const Pattern* pattern, const char* name);
+void pattern_free(Pattern* pattern);
+
+#endif  // PATTERN_H
@@ -0,0 +1,665 @@
+// Copyright Avram Cristian - Stefan 2022 stefanavram93@gmail.com
+// Copyright Dumitrescu Rares - Matei 2022 mateidum828@gmail.com
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdfs.h"
+#include "tree.h"
+#include "checkpoint.h"
+#include "export.h"
+#include "import.h"
+#include "index.h"
+#include "pattern.h"
+#include "search.h"
+#include "undo.h"
+#include "watch.h"
+
+// the largest number of events that are read from the ring at once
+#define WATCH_READ_BATCH 64
+
+struct SdfsTree {
+    FileTree tree;
+};
+
+struct SdfsIter {
+    IndexNode* entry;
+    char* prefix;
+    size_t prefix_len;
+};
+
+struct SdfsWatch {
+    uint64_t cursor;
+};
+
+// The callback of the caller, for the functions that give STATUS_* codes
+typedef struct ResultArg {
+    SdfsResult result;
+    void* arg;
+} ResultArg;
+
+typedef struct SearchArg {
+    SdfsVisit visit;
+    void* arg;
+} SearchArg;
+
+typedef struct ProgressArg {
+    SdfsProgress progress;
+    void* arg;
+} ProgressArg;
+
+/*
+* The STATUS_* codes of the tree have the same values as SdfsStatus
+* (STATUS_BUSY, STATUS_IO and STATUS_UNSUPPORTED too); only the missing
+* target of a link is reported as a missing entry.
+*/
+static inline SdfsStatus to_status(int status) {
+    return status == STATUS_NO_TARGET ? SDFS_NO_ENTRY : (SdfsStatus)status;
+}
+
+SdfsTree *sdfs_open(void) {
+    SdfsTree *tree = malloc(sizeof(SdfsTree));
+    tree->tree = createFileTree("root");
+    return tree;
+}
+
+// A transaction that was not committed is rolled back
+void sdfs_close(SdfsTree *tree) {
+    if (!tree)
+        return;
+    if (undo_active())
+        undo_rollback(tree->tree.root, NULL);
+    freeTree(tree->tree);
+    free(tree);
+}
+
+SdfsNode *sdfs_root(SdfsTree *tree) {
+    return tree->tree.root;
+}
+
+const char *sdfs_strerror(SdfsStatus status) {
+    static const char *messages[] = {
+        [SDFS_OK] = "Success",
+        [SDFS_EXISTS] = "File exists",
+        [SDFS_NO_ENTRY] = "No such file or directory",
+        [SDFS_NOT_DIR] = "Not a directory",
+        [SDFS_IS_DIR] = "Is a directory",
+        [SDFS_NOT_EMPTY] = "Directory not empty",
+        [SDFS_INVALID] = "Invalid argument",
+        [SDFS_RANGE] = "Buffer too small",
+        [SDFS_BUSY] = "Device or resource busy",
+        [SDFS_IO] = "Input/output error",
+        [SDFS_UNSUPPORTED] = "Not a file or directory"
+    };
+
+    if ((unsigned int)status > SDFS_UNSUPPORTED)
+        return "Unknown error";
+    return messages[status];
+}
+
+SdfsStatus sdfs_lookup(SdfsNode *cwd, const char *path, int follow,
+                       SdfsNode **node) {
+    if (!cwd || !path || !node)
+        return SDFS_INVALID;
+    *node = lookup_path(cwd, path, follow);
+    return *node ? SDFS_OK : SDFS_NO_ENTRY;
+}
+
+SdfsType sdfs_type(const SdfsNode *node) {
+    if (node->type == FOLDER_NODE)
+        return SDFS_FOLDER;
+    return node->type == SYMLINK_NODE ? SDFS_SYMLINK : SDFS_FILE;
+}
+
+const char *sdfs_name(const SdfsNode *node) {
+    return node->name;
+}
+
+unsigned int sdfs_id(const SdfsNode *node) {
+    return node->id;
+}
+
+SdfsNode *sdfs_parent(SdfsNode *node) {
+    return node->parent;
+}
+
+SdfsNode *sdfs_resolve(SdfsNode *node) {
+    return node ? resolve_link(node) : NULL;
+}
+
+// Copies the data and a terminator, if they fit in the buffer
+static SdfsStatus copy_out(const char *data, size_t data_len,
+                           char *buffer, size_t size, size_t *length) {
+    if (length)
+        *length = data_len;
+    if (data_len >= size)
+        return SDFS_RANGE;
+    memcpy(buffer, data, data_len);
+    buffer[data_len] = '\0';
+    return SDFS_OK;
+}
+
+SdfsStatus sdfs_path(const SdfsNode *node, char *buffer, size_t size,
+                     size_t *length) {
+    if (!node)
+        return SDFS_INVALID;
+    size_t path_len = node_path(node, buffer, size);
+    if (length)
+        *length = path_len;
+    return path_len < size ? SDFS_OK : SDFS_RANGE;
+}
+
+// The text of a file, or of the file that a link points to
+SdfsStatus sdfs_read(SdfsNode *node, char *buffer, size_t size,
+                     size_t *length) {
+    if (!node)
+        return SDFS_INVALID;
+    node = resolve_link(node);
+    if (!node)
+        return SDFS_NO_ENTRY;
+    if (node->type == FOLDER_NODE)
+        return SDFS_IS_DIR;
+
+    Blob *body = ((FileContent *)node->content)->body;
+    const char *text = blob_text(body);
+    if (!text)
+        return SDFS_IO;
+    return copy_out(text, body->size, buffer, size, length);
+}
+
+SdfsStatus sdfs_readlink(const SdfsNode *node, char *buffer, size_t size,
+                         size_t *length) {
+    if (!node || node->type != SYMLINK_NODE)
+        return SDFS_INVALID;
+    const char *target = ((LinkContent *)node->content)->target;
+    return copy_out(target, strlen(target), buffer, size, length);
+}
+
+// The folder that is listed; a link to a folder is followed
+static SdfsStatus list_folder(SdfsNode **folder) {
+    if (!*folder)
+        return SDFS_INVALID;
+    *folder = resolve_link(*folder);
+    if (!*folder)
+        return SDFS_NO_ENTRY;
+    return (*folder)->type == FOLDER_NODE ? SDFS_OK : SDFS_NOT_DIR;
+}
+
+SdfsStatus sdfs_child(SdfsNode *folder, const char *name, SdfsNode **node) {
+    if (!name || !node)
+        return SDFS_INVALID;
+    SdfsStatus status = list_folder(&folder);
+    if (status != SDFS_OK)
+        return status;
+
+    ListNode *child = find_child(folder, name, NULL);
+    *node = child ? child->info : NULL;
+    return child ? SDFS_OK : SDFS_NO_ENTRY;
+}
+
+SdfsStatus sdfs_list(SdfsNode *folder, SdfsVisit visit, void *arg) {
+    SdfsStatus status = list_folder(&folder);
+    if (status != SDFS_OK)
+        return status;
+
+    FolderContent *directory_content = folder->content;
+    if (!directory_content)
+        return SDFS_OK;
+    for (ListNode *child = directory_content->children->head; child;
+         child = child->next) {
+        if (visit(child->info, 0, arg))
+            break;
+    }
+    return SDFS_OK;
+}
+
+// Returns non-zero if the visit was stopped
+static int walk_children(TreeNode *folder, int depth, SdfsVisit visit,
+                         void *arg) {
+    FolderContent *directory_content = folder->content;
+    if (!directory_content)
+        return 0;
+
+    for (ListNode *child = directory_content->children->head; child;
+         child = child->next) {
+        if (visit(child->info, depth, arg))
+            return 1;
+        if (child->info->type == FOLDER_NODE &&
+            walk_children(child->info, depth + 1, visit, arg))
+            return 1;
+    }
+    return 0;
+}
+
+SdfsStatus sdfs_walk(SdfsNode *folder, SdfsVisit visit, void *arg) {
+    SdfsStatus status = list_folder(&folder);
+    if (status != SDFS_OK)
+        return status;
+    walk_children(folder, 0, visit, arg);
+    return SDFS_OK;
+}
+
+/*
+* The iterator starts at the first name that is not smaller than the
+* prefix, found in the sorted index of the folder, and stops at the
+* first name that does not start with it.
+*/
+SdfsStatus sdfs_iter_open(SdfsNode *folder, const char *prefix,
+                          SdfsIter **iter) {
+    SdfsStatus status = list_folder(&folder);
+    if (status != SDFS_OK)
+        return status;
+    if (!prefix)
+        prefix = "";
+
+    SdfsIter *new_iter = malloc(sizeof(SdfsIter));
+    NameIndex *index = folder_index(folder);
+    new_iter->prefix_len = strlen(prefix);
+    new_iter->prefix = malloc(new_iter->prefix_len + 1);
+    memcpy(new_iter->prefix, prefix, new_iter->prefix_len + 1);
+    new_iter->entry = index ? index_seek(index, prefix) : NULL;
+
+    *iter = new_iter;
+    return SDFS_OK;
+}
+
+/*
+* The first entry of the page is found through the positions kept by
+* the index; the positions are unsigned int, so a bigger offset is
+* always after the last child.
+*/
+SdfsStatus sdfs_iter_at(SdfsNode *folder, size_t offset, SdfsIter **iter) {
+    SdfsStatus status = sdfs_iter_open(folder, NULL, iter);
+    if (status != SDFS_OK)
+        return status;
+
+    NameIndex *index = folder_index(resolve_link(folder));
+    (*iter)->entry = NULL;
+    if (index && offset <= UINT_MAX)
+        (*iter)->entry = index_at(index, offset);
+    return SDFS_OK;
+}
+
+SdfsNode *sdfs_iter_next(SdfsIter *iter) {
+    IndexNode *entry = iter->entry;
+    if (!entry || strncmp(entry->info->name, iter->prefix, iter->prefix_len))
+        return NULL;
+    iter->entry = index_next(entry);
+    return entry->info;
+}
+
+void sdfs_iter_close(SdfsIter *iter) {
+    if (!iter)
+        return;
+    free(iter->prefix);
+    free(iter);
+}
+
+int sdfs_is_pattern(const char *path) {
+    return path && has_wildcards(path);
+}
+
+SdfsStatus sdfs_glob(SdfsNode *cwd, const char *pattern, SdfsVisit visit,
+                     void *arg) {
+    if (!cwd || !pattern)
+        return SDFS_INVALID;
+
+    int count;
+    TreeNode **matches = glob_collect(cwd, pattern, &count);
+    if (count < 0)
+        return SDFS_NO_ENTRY;
+    for (int i = 0; i < count; i++) {
+        if (visit(matches[i], 0, arg))
+            break;
+    }
+    free(matches);
+    return SDFS_OK;
+}
+
+static SdfsStatus run_one(SdfsNode *cwd, const char *path, int kind,
+                          const char *text, size_t size) {
+    if (!cwd || !path)
+        return SDFS_INVALID;
+    return to_status(batch_one(cwd, path, kind, text, size));
+}
+
+SdfsStatus sdfs_mkdir(SdfsNode *cwd, const char *path) {
+    return run_one(cwd, path, BATCH_MKDIR, NULL, 0);
+}
+
+SdfsStatus sdfs_touch(SdfsNode *cwd, const char *path, const char *text,
+                      size_t size) {
+    return run_one(cwd, path, BATCH_TOUCH, text ? text : "",
+                   text ? size : 0);
+}
+
+SdfsStatus sdfs_rm(SdfsNode *cwd, const char *path) {
+    return run_one(cwd, path, BATCH_RM, NULL, 0);
+}
+
+SdfsStatus sdfs_rmdir(SdfsNode *cwd, const char *path) {
+    return run_one(cwd, path, BATCH_RMDIR, NULL, 0);
+}
+
+SdfsStatus sdfs_rmrec(SdfsNode *cwd, const char *path) {
+    return run_one(cwd, path, BATCH_RMREC, NULL, 0);
+}
+
+// Copies a file; the destination is an existing folder or file
+SdfsStatus sdfs_cp(SdfsNode *cwd, const char *source,
+                   const char *destination) {
+    if (!cwd || !source || !destination)
+        return SDFS_INVALID;
+
+    TreeNode *source_node = walk_path(cwd, source);
+    if (!source_node)
+        return SDFS_NO_ENTRY;
+    if (source_node->type == FOLDER_NODE)
+        return SDFS_IS_DIR;
+
+    TreeNode *dest_node = walk_path(cwd, destination);
+    if (!dest_node)
+        return SDFS_NO_ENTRY;
+    return to_status(copy_into(source_node, dest_node));
+}
+
+// Moves a node (a link is moved itself) into an existing folder or file
+SdfsStatus sdfs_mv(SdfsNode *cwd, const char *source,
+                   const char *destination) {
+    if (!cwd || !source || !destination)
+        return SDFS_INVALID;
+
+    TreeNode *source_node = lookup_path(cwd, source, 0);
+    if (!source_node)
+        return SDFS_NO_ENTRY;
+    if (!source_node->parent)
+        return SDFS_INVALID;
+
+    TreeNode *dest_node = walk_path(cwd, destination);
+    if (!dest_node)
+        return SDFS_NO_ENTRY;
+    return to_status(move_into(source_node, dest_node));
+}
+
+SdfsStatus sdfs_ln(SdfsNode *cwd, const char *target, const char *linkName,
+                   int symbolic) {
+    if (!cwd || !target || !linkName)
+        return SDFS_INVALID;
+    return to_status(link_path(cwd, target, linkName, symbolic));
+}
+
+/*
+* The operations of SdfsOp are in the order of the BATCH_* kinds. The
+* statuses are written by the tree as STATUS_* codes, then converted.
+*/
+SdfsStatus sdfs_batch(SdfsNode *cwd, SdfsOp op, const char *const *paths,
+                      int count, const char *text, size_t size,
+                      SdfsStatus *statuses) {
+    if (!cwd || !paths || count < 0 || !statuses ||
+        (unsigned int)op > SDFS_RMREC)
+        return SDFS_INVALID;
+    for (int i = 0; i < count; i++) {
+        if (!paths[i])
+            return SDFS_INVALID;
+    }
+    if (!count)
+        return SDFS_OK;
+
+    int *results = malloc(count * sizeof(int));
+    batch_many(cwd, paths, count, op, text ? text : "", text ? size : 0,
+               results);
+
+    SdfsStatus first = SDFS_OK;
+    for (int i = 0; i < count; i++) {
+        statuses[i] = to_status(results[i]);
+        if (first == SDFS_OK)
+            first = statuses[i];
+    }
+    free(results);
+    return first;
+}
+
+static void give_result(const char *name, int status, void *arg) {
+    ResultArg *result_arg = arg;
+    result_arg->result(name, to_status(status), result_arg->arg);
+}
+
+SdfsStatus sdfs_rm_glob(SdfsNode *cwd, const char *pattern, int recursive,
+                        SdfsResult result, void *arg) {
+    if (!cwd || !pattern || !result)
+        return SDFS_INVALID;
+
+    ResultArg result_arg = {.result = result, .arg = arg};
+    return to_status(remove_matching(cwd, pattern, recursive, give_result,
+                                     &result_arg));
+}
+
+SdfsStatus sdfs_copy_into(SdfsNode *source, SdfsNode *dest) {
+    if (!source || !dest)
+        return SDFS_INVALID;
+    source = resolve_link(source);
+    if (!source)
+        return SDFS_NO_ENTRY;
+    if (source->type == FOLDER_NODE)
+        return SDFS_IS_DIR;
+    return to_status(copy_into(source, dest));
+}
+
+SdfsStatus sdfs_move_into(SdfsNode *source, SdfsNode *dest) {
+    if (!source || !dest || !source->parent)
+        return SDFS_INVALID;
+    return to_status(move_into(source, dest));
+}
+
+SdfsStatus sdfs_begin(void) {
+    return undo_begin() ? SDFS_OK : SDFS_BUSY;
+}
+
+SdfsStatus sdfs_commit(SdfsNode **cwd, size_t *changes) {
+    size_t nr_of_records;
+    if (!undo_active())
+        return SDFS_INVALID;
+    *cwd = undo_commit(*cwd, &nr_of_records);
+    if (changes)
+        *changes = nr_of_records;
+    return SDFS_OK;
+}
+
+SdfsStatus sdfs_abort(SdfsNode **cwd, size_t *changes) {
+    size_t nr_of_records;
+    if (!undo_active())
+        return SDFS_INVALID;
+    *cwd = undo_rollback(*cwd, &nr_of_records);
+    if (changes)
+        *changes = nr_of_records;
+    return SDFS_OK;
+}
+
+SdfsStatus sdfs_usage(SdfsNode *node, SdfsUsage *usage) {
+    if (!node || !usage)
+        return SDFS_INVALID;
+    disk_usage(node, &usage->nr_of_files, &usage->logical_bytes,
+               &usage->stored_bytes);
+    return SDFS_OK;
+}
+
+void sdfs_store_stats(SdfsStoreStats *stats) {
+    StoreStats store;
+    store_stats(&store);
+
+    stats->nr_of_blobs = store.nr_of_blobs;
+    stats->nr_of_refs = store.nr_of_refs;
+    stats->stored_bytes = store.stored_bytes;
+    stats->logical_bytes = store.logical_bytes;
+    stats->budget = store.budget;
+    stats->resident_bytes = store.resident_bytes;
+    stats->nr_of_spilled = store.nr_of_spilled;
+    stats->spill_bytes = store.spill_bytes;
+    stats->nr_of_evictions = store.nr_of_evictions;
+    stats->nr_of_faults = store.nr_of_faults;
+    stats->compress_min = store.compress_min;
+    stats->nr_of_packed = store.nr_of_packed;
+    stats->packed_bytes = store.packed_bytes;
+    stats->unpacked_bytes = store.unpacked_bytes;
+    stats->nr_of_decodes = store.nr_of_decodes;
+    stats->decode_ms = store.decode_ms;
+}
+
+void sdfs_set_budget(size_t budget) {
+    store_set_budget(budget);
+}
+
+void sdfs_set_compression(size_t minSize) {
+    store_set_compression(minSize);
+}
+
+static void give_match(TreeNode *node, int depth, void *arg) {
+    SearchArg *search_arg = arg;
+    search_arg->visit(node, depth, search_arg->arg);
+}
+
+// The word is checked before the folder, like the *search* command does
+SdfsStatus sdfs_search(SdfsNode *cwd, const char *path, const char *word,
+                       SdfsVisit visit, void *arg, SdfsSearchStats *stats) {
+    if (!cwd || !path || !word || !visit || !stats)
+        return SDFS_INVALID;
+
+    SearchArg search_arg = {.visit = visit, .arg = arg};
+    SearchStats search;
+    int status = search_word(walk_path(cwd, path), word, give_match,
+                             &search_arg, &search);
+    if (status != STATUS_OK && status != STATUS_IO)
+        return to_status(status);
+
+    stats->index_built = search.built;
+    stats->build_ms = search.build_ms;
+    stats->nr_of_matches = search.found;
+    stats->search_ms = search.search_ms;
+    stats->nr_of_files = search.nr_of_files;
+    stats->nr_of_words = search.nr_of_tokens;
+    stats->nr_of_postings = search.nr_of_postings;
+    stats->memory = search.memory;
+    return to_status(status);
+}
+
+static void export_stats(SdfsHostStats *stats, const ExportStats *export) {
+    stats->nr_of_dir = export->nr_of_dir;
+    stats->nr_of_files = export->nr_of_files;
+    stats->nr_of_links = 0;
+    stats->nr_of_bytes = export->nr_of_bytes;
+    stats->nr_skipped = 0;
+}
+
+SdfsStatus sdfs_import(SdfsNode *folder, const char *hostPath,
+                       SdfsHostStats *stats) {
+    if (!folder || !hostPath || !stats)
+        return SDFS_INVALID;
+
+    ImportStats import;
+    int status = import_host(folder, hostPath, &import);
+    if (status != STATUS_OK)
+        return to_status(status);
+
+    stats->nr_of_dir = import.nr_of_dir;
+    stats->nr_of_files = import.nr_of_files;
+    stats->nr_of_links = import.nr_of_links;
+    stats->nr_of_bytes = 0;
+    stats->nr_skipped = import.nr_skipped;
+    return SDFS_OK;
+}
+
+SdfsStatus sdfs_export_archive(SdfsNode *node, int fd, SdfsHostStats *stats) {
+    if (!node || !stats)
+        return SDFS_INVALID;
+
+    ExportStats export;
+    int failed = write_archive(node, fd, NULL, NULL, &export) < 0;
+    export_stats(stats, &export);
+    return failed ? SDFS_IO : SDFS_OK;
+}
+
+SdfsStatus sdfs_export_dir(SdfsNode *node, int dirFd, SdfsHostStats *stats) {
+    if (!node || !stats)
+        return SDFS_INVALID;
+
+    ExportStats export;
+    int failed = export_dir(node, dirFd, &export) < 0;
+    export_stats(stats, &export);
+    return failed ? SDFS_IO : SDFS_OK;
+}
+
+SdfsStatus sdfs_checkpoint(SdfsNode *node, const char *path, double *forkMs) {
+    if (!node || !path || !forkMs)
+        return SDFS_INVALID;
+    return to_status(checkpoint_start(node, path, forkMs));
+}
+
+const char *sdfs_checkpoint_path(void) {
+    return checkpoint_path();
+}
+
+static void give_report(const CheckpointReport *report, const char *path,
+                        void *arg) {
+    ProgressArg *progress_arg = arg;
+    SdfsReport sdfs_report;
+
+    sdfs_report.type = report->type == REPORT_PROGRESS ? SDFS_REPORT_PROGRESS
+                       : report->type == REPORT_DONE ? SDFS_REPORT_DONE
+                                                      : SDFS_REPORT_FAILED;
+    sdfs_report.path = path;
+    sdfs_report.nr_of_nodes = report->nr_of_nodes;
+    sdfs_report.total = report->total;
+    export_stats(&sdfs_report.stats, &report->stats);
+    sdfs_report.elapsed_ms = report->elapsed;
+    sdfs_report.error = report->error;
+    progress_arg->progress(&sdfs_report, progress_arg->arg);
+}
+
+void sdfs_checkpoint_poll(int wait, SdfsProgress progress, void *arg) {
+    ProgressArg progress_arg = {.progress = progress, .arg = arg};
+    checkpoint_poll(wait, give_report, &progress_arg);
+}
+
+SdfsWatch *sdfs_watch_open(void) {
+    SdfsWatch *watch = malloc(sizeof(SdfsWatch));
+    watch->cursor = watch_subscribe();
+    return watch;
+}
+
+/*
+* The events are read from the ring in small batches, as the event of
+* the ring and the one of the API do not have the same layout.
+*/
+size_t sdfs_watch_read(SdfsWatch *watch, SdfsEvent *events, size_t max,
+                       unsigned long long *lost) {
+    WatchEvent batch[WATCH_READ_BATCH];
+    uint64_t nr_lost = 0;
+    size_t count = 0;
+
+    while (count < max) {
+        size_t wanted = max - count, read;
+        if (wanted > WATCH_READ_BATCH)
+            wanted = WATCH_READ_BATCH;
+
+        read = watch_read(&watch->cursor, batch, wanted, &nr_lost);
+        for (size_t i = 0; i < read; i++, count++) {
+            events[count].seq = batch[i].seq;
+            events[count].type = (SdfsEventType)batch[i].type;
+            events[count].node_id = batch[i].node_id;
+            events[count].parent_id = batch[i].parent_id;
+            memcpy(events[count].name, batch[i].name, SDFS_EVENT_NAME_LEN);
+        }
+        if (read < wanted)
+            break;
+    }
+    if (lost)
+        *lost += nr_lost;
+    return count;
+}
+
+void sdfs_watch_close(SdfsWatch *watch) {
+    if (!watch)
+        return;
+    watch_unsubscribe();
+    free(watch);
+}
@@ -0,0 +1,323 @@
+#ifndef SDFS_H
+#define SDFS_H
+
+#include <stddef.h>
+
+/*
+* The library API of the simulated file system (libsdfs). Nothing is
+* printed: every call returns a status, and the results are given back
+* through node handles, callbacks, iterators and buffers of the caller.
+*
+* The tree keeps global state (the content store, the search index, the
+* undo log and the watch ring), so only one tree may be open at a time,
+* and the calls must not be made from more than one thread at once.
+*/
+
+#define SDFS_API __attribute__((visibility("default")))
+
+typedef struct SdfsTree SdfsTree;
+typedef struct TreeNode SdfsNode;  // valid until the node is removed
+typedef struct SdfsIter SdfsIter;
+
+typedef enum SdfsStatus {
+    SDFS_OK = 0,
+    SDFS_EXISTS,     // the name is already used
+    SDFS_NO_ENTRY,   // the path, or one of its folders, does not exist
+    SDFS_NOT_DIR,    // a folder was expected
+    SDFS_IS_DIR,     // a file was expected
+    SDFS_NOT_EMPTY,  // the folder has children
+    SDFS_INVALID,    // a bad argument, or a move into itself
+    SDFS_RANGE,      // the buffer is too small; the length is still given
+    SDFS_BUSY,       // a transaction (or a checkpoint) is in progress, or
+                     // the node to remove holds the current folder (cwd)
+    SDFS_IO,         // the host file system (or the spill file) failed,
+                     // or a stored text is corrupt; errno tells why
+    SDFS_UNSUPPORTED  // a host entry that is not a file or a directory
+} SdfsStatus;
+
+typedef enum SdfsType {
+    SDFS_FILE,
+    SDFS_FOLDER,
+    SDFS_SYMLINK
+} SdfsType;
+
+// the operations of sdfs_batch, named after the commands
+typedef enum SdfsOp {
+    SDFS_MKDIR,
+    SDFS_TOUCH,
+    SDFS_RM,
+    SDFS_RMDIR,
+    SDFS_RMREC
+} SdfsOp;
+
+/*
+* Called for every node of a listing; "depth" is 0 for the children of
+* the listed folder. A non-zero return stops the listing.
+*/
+typedef int (*SdfsVisit)(SdfsNode* node, int depth, void* arg);
+
+// Called for every node matched by a removal, before it is freed
+typedef void (*SdfsResult)(const char* name, SdfsStatus status, void* arg);
+
+SDFS_API SdfsTree* sdfs_open(void);
+SDFS_API void sdfs_close(SdfsTree* tree);
+SDFS_API SdfsNode* sdfs_root(SdfsTree* tree);
+SDFS_API const char* sdfs_strerror(SdfsStatus status);
+
+// lookups; "follow" tells if a symbolic link at the end is followed
+SDFS_API SdfsStatus sdfs_lookup(SdfsNode* cwd, const char* path,
+                                int follow, SdfsNode** node);
+SDFS_API SdfsType sdfs_type(const SdfsNode* node);
+SDFS_API const char* sdfs_name(const SdfsNode* node);
+SDFS_API unsigned int sdfs_id(const SdfsNode* node);
+SDFS_API SdfsNode* sdfs_parent(SdfsNode* node);
+
+/*
+* sdfs_child looks for the name among the children, without giving any
+* meaning to "/", "." or "..". sdfs_resolve returns the node that a link
+* points to (the node itself if it is not a link), or NULL.
+*/
+SDFS_API SdfsStatus sdfs_child(SdfsNode* folder, const char* name,
+                               SdfsNode** node);
+SDFS_API SdfsNode* sdfs_resolve(SdfsNode* node);
+
+/*
+* The results are written in a buffer of "size" bytes, ended by '\0'.
+* "length" always receives the full length, so SDFS_RANGE tells the
+* caller to retry with a buffer of at least *length + 1 bytes.
+* sdfs_read returns SDFS_IO if the text can not be read back from the
+* spill file, or can not be decoded.
+*/
+SDFS_API SdfsStatus sdfs_path(const SdfsNode* node, char* buffer,
+                              size_t size, size_t* length);
+SDFS_API SdfsStatus sdfs_read(SdfsNode* node, char* buffer, size_t size,
+                              size_t* length);
+SDFS_API SdfsStatus sdfs_readlink(const SdfsNode* node, char* buffer,
+                                  size_t size, size_t* length);
+
+/*
+* sdfs_list visits the children in the order they were added and
+* sdfs_walk the whole subtree (without following links). The iterator
+* gives the children sorted by name, only those that start with
+* "prefix" (NULL for all); it is invalid after the folder changes.
+* sdfs_iter_at gives them all, from the one at the position "offset" of
+* the sorted order, which is found without passing the ones before it.
+*/
+SDFS_API SdfsStatus sdfs_list(SdfsNode* folder, SdfsVisit visit,
+                              void* arg);
+SDFS_API SdfsStatus sdfs_walk(SdfsNode* folder, SdfsVisit visit,
+                              void* arg);
+SDFS_API SdfsStatus sdfs_iter_open(SdfsNode* folder, const char* prefix,
+                                   SdfsIter** iter);
+SDFS_API SdfsStatus sdfs_iter_at(SdfsNode* folder, size_t offset,
+                                 SdfsIter** iter);
+SDFS_API SdfsNode* sdfs_iter_next(SdfsIter* iter);
+SDFS_API void sdfs_iter_close(SdfsIter* iter);
+
+/*
+* A pattern ("dir/log_*") may use '*', '?' and '[...]' in its last
+* component. sdfs_glob visits the children of the folder that match, in
+* the order they were added; it returns SDFS_NO_ENTRY if the folder does
+* not exist.
+*/
+SDFS_API int sdfs_is_pattern(const char* path);
+SDFS_API SdfsStatus sdfs_glob(SdfsNode* cwd, const char* pattern,
+                              SdfsVisit visit, void* arg);
+
+// changes of the tree, with the rules of the commands of the same name
+SDFS_API SdfsStatus sdfs_mkdir(SdfsNode* cwd, const char* path);
+SDFS_API SdfsStatus sdfs_touch(SdfsNode* cwd, const char* path,
+                               const char* text, size_t size);
+SDFS_API SdfsStatus sdfs_rm(SdfsNode* cwd, const char* path);
+SDFS_API SdfsStatus sdfs_rmdir(SdfsNode* cwd, const char* path);
+SDFS_API SdfsStatus sdfs_rmrec(SdfsNode* cwd, const char* path);
+SDFS_API SdfsStatus sdfs_cp(SdfsNode* cwd, const char* source,
+                            const char* destination);
+SDFS_API SdfsStatus sdfs_mv(SdfsNode* cwd, const char* source,
+                            const char* destination);
+SDFS_API SdfsStatus sdfs_ln(SdfsNode* cwd, const char* target,
+                            const char* linkName, int symbolic);
+
+/*
+* Runs the operation for "count" targets at once and writes the status of
+* every target in "statuses"; returns the first status that is not
+* SDFS_OK. The targets are taken as the command takes them: an existing
+* file is SDFS_EXISTS for SDFS_TOUCH too, and the names are not checked.
+* "text" (of "size" bytes) is the text of the files made by SDFS_TOUCH.
+*/
+SDFS_API SdfsStatus sdfs_batch(SdfsNode* cwd, SdfsOp op,
+                               const char* const* paths, int count,
+                               const char* text, size_t size,
+                               SdfsStatus* statuses);
+
+/*
+* Removes the nodes that match the pattern (folders too, if "recursive"
+* is set). Every match is given to "result"; the folders that are kept
+* get SDFS_IS_DIR, the ones that hold the cwd SDFS_BUSY. Returns
+* SDFS_NO_ENTRY if nothing matched.
+*/
+SDFS_API SdfsStatus sdfs_rm_glob(SdfsNode* cwd, const char* pattern,
+                                 int recursive, SdfsResult result,
+                                 void* arg);
+
+/*
+* The same as sdfs_cp and sdfs_mv, for nodes that were already found.
+* sdfs_copy_into follows a link given as the source; SDFS_IS_DIR means
+* that the source is a folder, or that a folder would be overwritten.
+*/
+SDFS_API SdfsStatus sdfs_copy_into(SdfsNode* source, SdfsNode* dest);
+SDFS_API SdfsStatus sdfs_move_into(SdfsNode* source, SdfsNode* dest);
+
+/*
+* A transaction records the changes until sdfs_commit keeps them or
+* sdfs_abort reverses them; "changes" (if not NULL) receives the number
+* of recorded changes. Both may free the folder in *cwd, so they move it
+* to the closest folder that is still in the tree. Without a transaction
+* in progress, they return SDFS_INVALID.
+*/
+SDFS_API SdfsStatus sdfs_begin(void);
+SDFS_API SdfsStatus sdfs_commit(SdfsNode** cwd, size_t* changes);
+SDFS_API SdfsStatus sdfs_abort(SdfsNode** cwd, size_t* changes);
+
+typedef struct SdfsUsage {
+    int nr_of_files;
+    size_t logical_bytes;  // the size of all the files
+    size_t stored_bytes;   // the size of their distinct texts
+} SdfsUsage;
+
+// The state of the content store, which keeps every distinct text once
+typedef struct SdfsStoreStats {
+    size_t nr_of_blobs;
+    size_t nr_of_refs;
+    size_t stored_bytes;    // bytes of the distinct contents
+    size_t logical_bytes;   // bytes of all the files, as if not shared
+    size_t budget;          // 0 if the contents are never evicted
+    size_t resident_bytes;  // bytes of the contents that are in memory
+    size_t nr_of_spilled;   // blobs that are only in the spill file
+    size_t spill_bytes;     // size of the spill file
+    size_t nr_of_evictions, nr_of_faults;
+    size_t compress_min;    // 0 if the new contents are not compressed
+    size_t nr_of_packed;    // blobs that are compressed in memory
+    size_t packed_bytes;    // their compressed size
+    size_t unpacked_bytes;  // their real size
+    size_t nr_of_decodes;
+    double decode_ms;
+} SdfsStoreStats;
+
+/*
+* sdfs_usage counts the files under a node (without following links).
+* The budget limits the memory of the texts, which are spilled to a file
+* over it; the texts of at least "minSize" bytes are kept compressed.
+* A value of 0 turns each of them off.
+*/
+SDFS_API SdfsStatus sdfs_usage(SdfsNode* node, SdfsUsage* usage);
+SDFS_API void sdfs_store_stats(SdfsStoreStats* stats);
+SDFS_API void sdfs_set_budget(size_t budget);
+SDFS_API void sdfs_set_compression(size_t minSize);
+
+typedef struct SdfsSearchStats {
+    int index_built;  // the index was built by this search
+    double build_ms;
+    size_t nr_of_matches;
+    double search_ms;
+    // the state of the index, after the search
+    size_t nr_of_files, nr_of_words, nr_of_postings, memory;
+} SdfsSearchStats;
+
+/*
+* Visits the files under the folder "path" whose text has the word, with
+* the depth of each one under the folder; the index of the words is
+* built by the first search. Returns SDFS_INVALID if "word" is empty or
+* is not a single word (letters, digits and '_'). SDFS_IO means that the
+* text of some files could not be read: the other files are still
+* visited and the stats are given.
+*/
+SDFS_API SdfsStatus sdfs_search(SdfsNode* cwd, const char* path,
+                                const char* word, SdfsVisit visit,
+                                void* arg, SdfsSearchStats* stats);
+
+typedef struct SdfsHostStats {
+    int nr_of_dir, nr_of_files;
+    int nr_of_links;     // the links read by an import (an export counts
+                         // them with the files, as tar entries)
+    size_t nr_of_bytes;  // written by an export
+    int nr_skipped;      // host entries that an import could not read
+} SdfsHostStats;
+
+/*
+* sdfs_import copies a host directory (or file) into the folder, under
+* the last component of the host path ("." and ".." are replaced by the
+* real name of the directory; SDFS_INVALID if it has none).
+* sdfs_export_archive writes the node as a POSIX tar archive to "fd",
+* sdfs_export_dir recreates it in the open host directory "dirFd"; both
+* return SDFS_IO (with errno set) when the host file system fails.
+*/
+SDFS_API SdfsStatus sdfs_import(SdfsNode* folder, const char* hostPath,
+                                SdfsHostStats* stats);
+SDFS_API SdfsStatus sdfs_export_archive(SdfsNode* node, int fd,
+                                        SdfsHostStats* stats);
+SDFS_API SdfsStatus sdfs_export_dir(SdfsNode* node, int dirFd,
+                                    SdfsHostStats* stats);
+
+typedef enum SdfsReportType {
+    SDFS_REPORT_PROGRESS,
+    SDFS_REPORT_DONE,
+    SDFS_REPORT_FAILED
+} SdfsReportType;
+
+typedef struct SdfsReport {
+    SdfsReportType type;
+    const char* path;  // the archive, valid during the callback
+    size_t nr_of_nodes, total;
+    SdfsHostStats stats;
+    double elapsed_ms;
+    int error;         // the errno of a failure; 0 if the writer died
+} SdfsReport;
+
+typedef void (*SdfsProgress)(const SdfsReport* report, void* arg);
+
+/*
+* A checkpoint writes the whole tree to a tar archive ("" for the default
+* path) from a child process, so the caller only waits for fork(), whose
+* time is given in "forkMs". The child's reports are given by
+* sdfs_checkpoint_poll, which blocks until the child is done if "wait"
+* is set. sdfs_checkpoint returns SDFS_BUSY while another checkpoint
+* (see sdfs_checkpoint_path) or a transaction is in progress.
+*/
+SDFS_API SdfsStatus sdfs_checkpoint(SdfsNode* node, const char* path,
+                                    double* forkMs);
+SDFS_API const char* sdfs_checkpoint_path(void);
+SDFS_API void sdfs_checkpoint_poll(int wait, SdfsProgress progress,
+                                   void* arg);
+
+typedef struct SdfsWatch SdfsWatch;
+
+typedef enum SdfsEventType {
+    SDFS_CREATE,
+    SDFS_DELETE,
+    SDFS_MODIFY,
+    SDFS_MOVED_FROM,
+    SDFS_MOVED_TO
+} SdfsEventType;
+
+#define SDFS_EVENT_NAME_LEN 44
+
+typedef struct SdfsEvent {
+    unsigned long long seq;
+    SdfsEventType type;
+    unsigned int node_id;
+    unsigned int parent_id;
+    char name[SDFS_EVENT_NAME_LEN];  // cut if it is longer
+} SdfsEvent;
+
+/*
+* A watch sees the changes of the whole tree made after it was opened.
+* sdfs_watch_read never blocks: it gives up to "max" events and adds to
+* *lost the ones that were overwritten before they could be read.
+*/
+SDFS_API SdfsWatch* sdfs_watch_open(void);
+SDFS_API size_t sdfs_watch_read(SdfsWatch* watch, SdfsEvent* events,
+                                size_t max, unsigned long long* lost);
+SDFS_API void sdfs_watch_close(SdfsWatch* watch);
+
+#endif  // SDFS_H
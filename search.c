@@ -0,0 +1,358 @@
+// Copyright Avram Cristian - Stefan 2022 stefanavram93@gmail.com
+// Copyright Dumitrescu Rares - Matei 2022 mateidum828@gmail.com
+
+#define _DEFAULT_SOURCE
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "search.h"
+
+#define SEARCH_INITIAL_BUCKETS 4096
+
+typedef struct Posting Posting;
+typedef struct PostingList PostingList;
+typedef struct IndexedFile IndexedFile;
+
+/*
+* A posting keeps the id of a file and the generation of its text.
+* When the text of a file changes, its generation is increased, so the
+* postings of the old text are skipped (and dropped) by the next search.
+*/
+struct Posting {
+    uint32_t id;
+    uint32_t gen;
+};
+
+struct PostingList {
+    char* token;
+    uint64_t hash;
+    uint32_t size, capacity;
+    Posting* items;
+    PostingList* next;  // next token from the same bucket
+};
+
+struct IndexedFile {
+    TreeNode* node;  // NULL if the file was removed
+    uint32_t gen;
+    int unread;      // the text could not be read, so it has no postings
+};
+
+static struct {
+    int enabled;
+    PostingList** buckets;
+    size_t nr_of_buckets, nr_of_tokens;
+    IndexedFile* files;  // indexed by the id of the nodes
+    size_t files_size, nr_of_files;
+    size_t nr_of_unread;  // the files that are read again by every search
+    size_t nr_of_postings, memory;
+    char* word;  // the lowercase copy of the last word, of any length
+    size_t word_size;
+} fts;
+
+static inline int is_word(char c) {
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+// Returns a lowercase copy of the word, valid until the next call
+static const char *lower_word(const char *word, size_t len) {
+    if (len >= fts.word_size) {
+        size_t new_size = fts.word_size ? fts.word_size : 64;
+        while (new_size <= len)
+            new_size *= 2;
+        fts.word = realloc(fts.word, new_size);
+        fts.memory += new_size - fts.word_size;
+        fts.word_size = new_size;
+    }
+    for (size_t i = 0; i < len; i++)
+        fts.word[i] = tolower((unsigned char)word[i]);
+    fts.word[len] = '\0';
+    return fts.word;
+}
+
+static double elapsed_ms(struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e3 +
+           (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static void grow_buckets(void) {
+    size_t new_size = fts.nr_of_buckets ? 2 * fts.nr_of_buckets
+                                        : SEARCH_INITIAL_BUCKETS;
+    PostingList **new_buckets = calloc(new_size, sizeof(PostingList *));
+
+    for (size_t i = 0; i < fts.nr_of_buckets; i++) {
+        PostingList *list = fts.buckets[i], *next;
+        while (list) {
+            next = list->next;
+            list->next = new_buckets[list->hash & (new_size - 1)];
+            new_buckets[list->hash & (new_size - 1)] = list;
+            list = next;
+        }
+    }
+    fts.memory += (new_size - fts.nr_of_buckets) * sizeof(PostingList *);
+    free(fts.buckets);
+    fts.buckets = new_buckets;
+    fts.nr_of_buckets = new_size;
+}
+
+static PostingList *find_list(const char *token, size_t len, int create) {
+    uint64_t hash = store_hash(token, len);
+
+    if (fts.nr_of_buckets) {
+        PostingList *list = fts.buckets[hash & (fts.nr_of_buckets - 1)];
+        for (; list; list = list->next) {
+            if (list->hash == hash && !strncmp(list->token, token, len) &&
+                list->token[len] == '\0')
+                return list;
+        }
+    }
+    if (!create)
+        return NULL;
+
+    if (fts.nr_of_tokens >= fts.nr_of_buckets)
+        grow_buckets();
+
+    PostingList *list = calloc(1, sizeof(PostingList));
+    list->token = malloc(len + 1);
+    memcpy(list->token, token, len);
+    list->token[len] = '\0';
+    list->hash = hash;
+
+    PostingList **bucket = &fts.buckets[hash & (fts.nr_of_buckets - 1)];
+    list->next = *bucket;
+    *bucket = list;
+    fts.nr_of_tokens++;
+    fts.memory += sizeof(PostingList) + len + 1;
+    return list;
+}
+
+static void add_posting(const char *token, size_t len, uint32_t id,
+                        uint32_t gen) {
+    PostingList *list = find_list(token, len, 1);
+
+    // a word that appears again in the same text is indexed only once
+    if (list->size && list->items[list->size - 1].id == id &&
+        list->items[list->size - 1].gen == gen)
+        return;
+
+    if (list->size == list->capacity) {
+        uint32_t capacity = list->capacity ? 2 * list->capacity : 4;
+        list->items = realloc(list->items, capacity * sizeof(Posting));
+        fts.memory += (capacity - list->capacity) * sizeof(Posting);
+        list->capacity = capacity;
+    }
+    list->items[list->size].id = id;
+    list->items[list->size].gen = gen;
+    list->size++;
+    fts.nr_of_postings++;
+}
+
+// Counts the files whose text could not be read
+static void set_unread(IndexedFile *file, int unread) {
+    if (file->unread != unread)
+        fts.nr_of_unread += unread ? 1 : -1;
+    file->unread = unread;
+}
+
+/*
+* Splits the text of the file in words (letters, digits and '_'),
+* converted to lowercase, and adds the file to the list of every word.
+* A file whose text can not be read is kept without words, until a
+* search reads it again.
+*/
+static void index_file(TreeNode *node) {
+    if (node->id >= fts.files_size) {
+        size_t new_size = fts.files_size ? fts.files_size : 1024;
+        while (new_size <= node->id)
+            new_size *= 2;
+        fts.files = realloc(fts.files, new_size * sizeof(IndexedFile));
+        memset(fts.files + fts.files_size, 0,
+               (new_size - fts.files_size) * sizeof(IndexedFile));
+        fts.memory += (new_size - fts.files_size) * sizeof(IndexedFile);
+        fts.files_size = new_size;
+    }
+
+    IndexedFile *file = &fts.files[node->id];
+    if (!file->node)
+        fts.nr_of_files++;
+    file->node = node;
+    file->gen++;
+
+    Blob *body = ((FileContent *)node->content)->body;
+    const char *text = blob_text(body);
+    set_unread(file, text == NULL);
+    if (!text)
+        return;
+
+    // the words are kept whole, whatever their length
+    size_t len = 0;
+    for (size_t i = 0; i <= body->size; i++) {
+        if (i < body->size && is_word(text[i])) {
+            len++;
+        } else if (len) {
+            add_posting(lower_word(text + i - len, len), len, node->id,
+                        file->gen);
+            len = 0;
+        }
+    }
+}
+
+static void index_subtree(TreeNode *node) {
+    if (node->type == FILE_NODE) {
+        index_file(node);
+        return;
+    }
+
+    // the symbolic links are not followed
+    FolderContent *directory_content = (FolderContent *)node->content;
+    if (node->type != FOLDER_NODE || !directory_content)
+        return;
+    for (ListNode *child = directory_content->children->head; child;
+         child = child->next)
+        index_subtree(child->info);
+}
+
+// Called for every new file, or for a folder with new files inside
+void search_add(TreeNode *node) {
+    if (fts.enabled)
+        index_subtree(node);
+}
+
+/*
+* Called when the text of a file is replaced. The text is shared by all
+* the hard links of the file, so the ones that are indexed are updated.
+*/
+void search_update(TreeNode *node) {
+    if (!fts.enabled)
+        return;
+
+    FileContent *file_content = (FileContent *)node->content;
+    if (!file_content->nodes) {
+        index_file(node);
+        return;
+    }
+    for (unsigned int i = 0; i < file_content->links; i++) {
+        TreeNode *link = file_content->nodes[i];
+        if (link == node || (link->id < fts.files_size &&
+                             fts.files[link->id].node == link))
+            index_file(link);
+    }
+}
+
+/*
+* Called when a file is freed (or for a folder, whose files are taken
+* out of the tree); the postings are dropped lazily.
+*/
+void search_remove(TreeNode *node) {
+    if (!fts.enabled)
+        return;
+
+    if (node->type == FOLDER_NODE) {
+        FolderContent *directory_content = (FolderContent *)node->content;
+        if (!directory_content)
+            return;
+        for (ListNode *child = directory_content->children->head; child;
+             child = child->next)
+            search_remove(child->info);
+        return;
+    }
+
+    if (node->id >= fts.files_size || fts.files[node->id].node != node)
+        return;
+
+    set_unread(&fts.files[node->id], 0);
+    fts.files[node->id].node = NULL;
+    fts.files[node->id].gen++;
+    fts.nr_of_files--;
+}
+
+// Returns the depth of the node under the folder (0 for a child), or -1
+static int depth_in(TreeNode *node, TreeNode *folder) {
+    int depth = -1;
+    for (; node; node = node->parent, depth++) {
+        if (node == folder)
+            return depth;
+    }
+    return -1;
+}
+
+// Indexes again the files whose text could not be read before
+static void index_unread(void) {
+    for (size_t id = 0; fts.nr_of_unread && id < fts.files_size; id++) {
+        if (fts.files[id].unread)
+            index_file(fts.files[id].node);
+    }
+}
+
+/*
+* Gives to "found" the files from the folder whose text contains the
+* word. The files come from the posting list of the word and are filtered
+* by following their parents up to the folder.
+*
+* The first search builds the index for the whole tree. Returns
+* STATUS_INVALID if the word is empty or is not a single word,
+* STATUS_NOT_DIR if the folder is missing, and STATUS_IO if the text of
+* a file can not be read (the other files are searched anyway).
+*/
+int search_word(TreeNode *folder, const char *word, SearchFound found,
+                void *foundArg, SearchStats *stats) {
+    struct timespec start;
+    size_t len = 0;
+
+    for (; word[len]; len++) {
+        if (!is_word(word[len]))
+            return STATUS_INVALID;
+    }
+    if (!len)
+        return STATUS_INVALID;
+    if (!folder || folder->type != FOLDER_NODE)
+        return STATUS_NOT_DIR;
+
+    stats->built = !fts.enabled;
+    stats->build_ms = 0;
+    if (!fts.enabled) {
+        TreeNode *root = folder;
+        while (root->parent)
+            root = root->parent;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        fts.enabled = 1;
+        index_subtree(root);
+        stats->build_ms = elapsed_ms(&start);
+    } else {
+        index_unread();
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    PostingList *list = find_list(lower_word(word, len), len, 0);
+    stats->found = 0;
+
+    if (list) {
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < list->size; i++) {
+            Posting posting = list->items[i];
+            IndexedFile *file = &fts.files[posting.id];
+            if (!file->node || file->gen != posting.gen)
+                continue;
+
+            list->items[kept++] = posting;
+            int depth = depth_in(file->node, folder);
+            if (depth >= 0) {
+                found(file->node, depth, foundArg);
+                stats->found++;
+            }
+        }
+        fts.nr_of_postings -= list->size - kept;
+        list->size = kept;
+    }
+
+    stats->search_ms = elapsed_ms(&start);
+    stats->nr_of_files = fts.nr_of_files;
+    stats->nr_of_tokens = fts.nr_of_tokens;
+    stats->nr_of_postings = fts.nr_of_postings;
+    stats->memory = fts.memory;
+    return fts.nr_of_unread ? STATUS_IO : STATUS_OK;
+}
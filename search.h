@@ -0,0 +1,28 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "node.h"
+
+typedef struct SearchStats SearchStats;
+typedef void (*SearchFound)(TreeNode* node, int depth, void* arg);
+
+struct SearchStats {
+    int built;  // the index was built by this search
+    double build_ms;
+    size_t found;
+    double search_ms;
+    // the state of the index, after the search
+    size_t nr_of_files, nr_of_tokens, nr_of_postings, memory;
+};
+
+/*
+* The inverted index is built by the first *search* command. Until then,
+* these functions do nothing, so the other commands pay nothing for it.
+*/
+void search_add(TreeNode* node);
+void search_update(TreeNode* node);
+void search_remove(TreeNode* node);
+int search_word(TreeNode* folder, const char* word, SearchFound found,
+                void* foundArg, SearchStats* stats);
+
+#endif  // SEARCH_H
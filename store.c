@@ -0,0 +1,627 @@
+// Copyright Avram Cristian - Stefan 2022 stefanavram93@gmail.com
+// Copyright Dumitrescu Rares - Matei 2022 mateidum828@gmail.com
+
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "lz.h"
+#include "store.h"
+
+#define STORE_INITIAL_BUCKETS 1024
+#define SPILL_TEMPLATE "sd_fs.spill.XXXXXX"
+#define STORE_DECODED_TEXTS 8
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+/*
+* The contents of all the files are kept in a hash table, keyed by their
+* xxHash64. A file that is created with a content that already exists
+* only takes one more reference to it.
+*
+* The table is protected by a mutex, as the import threads add contents
+* at the same time. The hash is computed before taking the lock.
+*/
+static pthread_mutex_t store_lock = PTHREAD_MUTEX_INITIALIZER;
+static Blob **buckets;
+static size_t nr_of_buckets;
+static StoreStats totals;
+static unsigned int last_mark;
+
+/*
+* The contents that are in memory form a ring, walked by the hand of the
+* CLOCK algorithm. A content that was read since the last pass of the
+* hand gets a second chance; otherwise, when the memory is over the
+* budget, it is compressed (unless compression is off), or evicted if it
+* is already compressed (or does not compress well).
+*
+* The spill file is only appended to: the contents never change, so a
+* content that is read back keeps its copy in the file, and evicting it
+* again only frees its memory.
+*/
+static struct {
+    Blob* hand;
+    // the compressed blobs whose text is decoded, the last read one first
+    Blob* decoded[STORE_DECODED_TEXTS];
+    int nr_of_decoded;
+    int fd;         // -1 until the first eviction
+    int read_only;  // set in a forked child, which shares the spill file
+} tier = {.hand = NULL, .nr_of_decoded = 0, .fd = -1, .read_only = 0};
+
+static inline uint64_t rotl64(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+static inline uint64_t read64(const char *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t read32(const char *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline uint64_t xxh_merge(uint64_t acc, uint64_t value) {
+    acc ^= xxh_round(0, value);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+// XXH64 with a seed of 0 (the input is read as little endian)
+uint64_t store_hash(const char *data, size_t size) {
+    const char *p = data, *end = data + size;
+    uint64_t h;
+
+    if (size >= 32) {
+        uint64_t v1 = PRIME64_1 + PRIME64_2, v2 = PRIME64_2;
+        uint64_t v3 = 0, v4 = -PRIME64_1;
+
+        do {
+            v1 = xxh_round(v1, read64(p));
+            v2 = xxh_round(v2, read64(p + 8));
+            v3 = xxh_round(v3, read64(p + 16));
+            v4 = xxh_round(v4, read64(p + 24));
+            p += 32;
+        } while (p + 32 <= end);
+
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxh_merge(h, v1);
+        h = xxh_merge(h, v2);
+        h = xxh_merge(h, v3);
+        h = xxh_merge(h, v4);
+    } else {
+        h = PRIME64_5;
+    }
+    h += size;
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= xxh_round(0, read64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)read32(p) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= (unsigned char)*p * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+// A new content is placed behind the hand, so it is reached last
+static void ring_insert(Blob *blob) {
+    if (!tier.hand) {
+        blob->older = blob->newer = blob;
+        tier.hand = blob;
+        return;
+    }
+    blob->newer = tier.hand;
+    blob->older = tier.hand->older;
+    tier.hand->older->newer = blob;
+    tier.hand->older = blob;
+}
+
+static void ring_remove(Blob *blob) {
+    if (blob->newer == blob) {
+        tier.hand = NULL;
+        return;
+    }
+    blob->older->newer = blob->newer;
+    blob->newer->older = blob->older;
+    if (tier.hand == blob)
+        tier.hand = blob->newer;
+}
+
+static inline size_t resident_size(Blob *blob) {
+    return (blob->data ? blob->size : 0) +
+           (blob->packed ? blob->packed_size : 0);
+}
+
+static void count_packed(Blob *blob, int added) {
+    if (added) {
+        totals.nr_of_packed++;
+        totals.packed_bytes += blob->packed_size;
+        totals.unpacked_bytes += blob->size;
+    } else {
+        totals.nr_of_packed--;
+        totals.packed_bytes -= blob->packed_size;
+        totals.unpacked_bytes -= blob->size;
+    }
+}
+
+// Returns the compressed text, or NULL if it would not save 1/8 of it
+static char *compress_text(const char *text, size_t size,
+                           size_t *packed_size) {
+    size_t capacity = size - size / 8;
+    char *packed = malloc(capacity);
+
+    *packed_size = lz_compress(text, size, packed, capacity);
+    if (!*packed_size) {
+        free(packed);
+        return NULL;
+    }
+    return realloc(packed, *packed_size);
+}
+
+static int pack(Blob *blob) {
+    blob->packed = compress_text(blob->data, blob->size,
+                                 &blob->packed_size);
+    if (!blob->packed) {
+        blob->packable = 0;
+        return -1;
+    }
+    free(blob->data);
+    blob->data = NULL;
+    totals.resident_bytes -= blob->size - blob->packed_size;
+    count_packed(blob, 1);
+    return 0;
+}
+
+// Takes the blob out of the decoded texts, if it is one of them
+static void forget_decoded(Blob *blob) {
+    for (int i = 0; i < tier.nr_of_decoded; i++) {
+        if (tier.decoded[i] == blob) {
+            memmove(tier.decoded + i, tier.decoded + i + 1,
+                    (--tier.nr_of_decoded - i) * sizeof(Blob *));
+            return;
+        }
+    }
+}
+
+// Moves a decoded text to the front, as the last read one
+static void touch_decoded(Blob *blob) {
+    forget_decoded(blob);
+    memmove(tier.decoded + 1, tier.decoded,
+            tier.nr_of_decoded++ * sizeof(Blob *));
+    tier.decoded[0] = blob;
+}
+
+// Frees the decoded copy of a compressed text
+static void drop_decoded(Blob *blob) {
+    free(blob->data);
+    blob->data = NULL;
+    totals.resident_bytes -= blob->size;
+    forget_decoded(blob);
+}
+
+/*
+* Decodes a compressed text. The last STORE_DECODED_TEXTS decoded texts
+* are kept, so the texts that are read in turn (by a search or an
+* export) are not decoded again, and the memory of the decoded copies
+* stays bounded. Returns -1 (with errno set to EIO) if the compressed
+* text is corrupt.
+*/
+static int unpack(Blob *blob) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    char *data = malloc(blob->size + 1);
+    if (lz_decompress(blob->packed, blob->packed_size, data,
+                      blob->size) < 0) {
+        free(data);
+        errno = EIO;
+        return -1;
+    }
+    data[blob->size] = '\0';
+
+    if (tier.nr_of_decoded == STORE_DECODED_TEXTS)
+        drop_decoded(tier.decoded[STORE_DECODED_TEXTS - 1]);
+    blob->data = data;
+    touch_decoded(blob);
+    totals.resident_bytes += blob->size;
+    totals.nr_of_decodes++;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    totals.decode_ms += (end.tv_sec - start.tv_sec) * 1e3 +
+                        (end.tv_nsec - start.tv_nsec) / 1e6;
+    return 0;
+}
+
+/*
+* The spill file is created in the current directory and unlinked at
+* once, so it disappears when the program ends.
+*/
+static int spill_open(void) {
+    if (tier.fd >= 0)
+        return 0;
+
+    char path[] = SPILL_TEMPLATE;
+    tier.fd = mkstemp(path);
+    if (tier.fd < 0)
+        return -1;
+    unlink(path);
+    return 0;
+}
+
+/*
+* Frees the memory of the content. It is written to the spill file first
+* (compressed, if it is compressed now), unless it is there already.
+* Returns 0, or -1 if the content could not be written.
+*/
+static int spill_out(Blob *blob) {
+    if (blob->spill < 0) {
+        const char *text = blob->packed ? blob->packed : blob->data;
+        size_t size = blob->packed ? blob->packed_size : blob->size;
+
+        if (spill_open() < 0)
+            return -1;
+        size_t done = 0;
+        while (done < size) {
+            ssize_t bytes = pwrite(tier.fd, text + done, size - done,
+                                   totals.spill_bytes + done);
+            if (bytes < 0 && errno == EINTR)
+                continue;
+            if (bytes <= 0)
+                return -1;
+            done += bytes;
+        }
+        blob->spill = totals.spill_bytes;
+        blob->spill_packed = blob->packed != NULL;
+        totals.spill_bytes += size;
+    }
+
+    ring_remove(blob);
+    totals.resident_bytes -= resident_size(blob);
+    if (blob->packed)
+        count_packed(blob, 0);
+    forget_decoded(blob);
+    free(blob->data);
+    free(blob->packed);
+    blob->data = blob->packed = NULL;
+    totals.nr_of_spilled++;
+    totals.nr_of_evictions++;
+    return 0;
+}
+
+/*
+* Frees memory until it is under the budget. Three turns of the hand are
+* enough: one to clear every "referenced" flag, one to compress and one
+* to evict. "keep" (the content that is being read) is never touched,
+* and neither are the empty ones, which would free nothing.
+*/
+static void enforce_budget(Blob *keep) {
+    size_t steps = 3 * (totals.nr_of_blobs - totals.nr_of_spilled) + 1;
+
+    while (totals.budget && totals.resident_bytes > totals.budget &&
+           tier.hand && steps--) {
+        Blob *blob = tier.hand;
+        tier.hand = blob->newer;
+
+        if (blob == keep || !blob->size)
+            continue;
+        if (blob->referenced) {
+            blob->referenced = 0;
+            continue;
+        }
+        if (blob->data && blob->packed) {
+            drop_decoded(blob);
+            continue;
+        }
+        if (blob->data && blob->packable && totals.compress_min &&
+            blob->size >= LZ_MIN_SIZE && pack(blob) == 0)
+            continue;
+        // the child of a checkpoint may only drop what is already saved
+        if (blob->spill < 0 && tier.read_only)
+            continue;
+        if (spill_out(blob) < 0)
+            return;
+    }
+}
+
+/*
+* Reads an evicted content back (compressed, if it was evicted so).
+* Returns -1 (with errno set) if the spill file can not be read; the
+* content stays evicted, so a later read tries again.
+*/
+static int fault_in(Blob *blob) {
+    size_t size = blob->spill_packed ? blob->packed_size : blob->size;
+    char *text = malloc(size + 1);
+    size_t done = 0;
+
+    while (done < size) {
+        ssize_t bytes = pread(tier.fd, text + done, size - done,
+                              blob->spill + done);
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes <= 0) {
+            // the end of the file is reached only if it was cut
+            if (bytes == 0)
+                errno = EIO;
+            free(text);
+            return -1;
+        }
+        done += bytes;
+    }
+
+    if (blob->spill_packed) {
+        blob->packed = text;
+        count_packed(blob, 1);
+    } else {
+        text[size] = '\0';
+        blob->data = text;
+    }
+    ring_insert(blob);
+    totals.resident_bytes += size;
+    totals.nr_of_spilled--;
+    totals.nr_of_faults++;
+    return 0;
+}
+
+// Makes the text of the content available in "data"; returns -1 if not
+static int load_text(Blob *blob) {
+    if (!blob->data && !blob->packed && fault_in(blob) < 0)
+        return -1;
+    if (!blob->data && unpack(blob) < 0)
+        return -1;
+    blob->referenced = 1;
+    enforce_budget(blob);
+    return 0;
+}
+
+// The table is doubled when it has more blobs than buckets
+static void grow_table(void) {
+    size_t new_size = nr_of_buckets ? 2 * nr_of_buckets
+                                    : STORE_INITIAL_BUCKETS;
+    Blob **new_buckets = calloc(new_size, sizeof(Blob *));
+
+    for (size_t i = 0; i < nr_of_buckets; i++) {
+        Blob *blob = buckets[i], *next;
+        while (blob) {
+            next = blob->next;
+            blob->next = new_buckets[blob->hash & (new_size - 1)];
+            new_buckets[blob->hash & (new_size - 1)] = blob;
+            blob = next;
+        }
+    }
+    free(buckets);
+    buckets = new_buckets;
+    nr_of_buckets = new_size;
+}
+
+/*
+* Searches the content in the table and takes a reference to it.
+* If it does not exist, "text" is kept as a new blob when "owned" is set,
+* or copied otherwise. A buffer that is owned but not kept is freed.
+*/
+static Blob *intern(char *text, size_t size, int owned) {
+    uint64_t hash = store_hash(text, size);
+
+    // compressed before taking the lock too, even if the text exists
+    size_t packed_size = 0;
+    char *packed = NULL;
+    int tried = totals.compress_min && size >= totals.compress_min &&
+                size >= LZ_MIN_SIZE;
+    if (tried)
+        packed = compress_text(text, size, &packed_size);
+
+    pthread_mutex_lock(&store_lock);
+    if (totals.nr_of_blobs >= nr_of_buckets)
+        grow_table();
+
+    Blob **bucket = &buckets[hash & (nr_of_buckets - 1)];
+    Blob *blob = *bucket;
+    for (; blob; blob = blob->next) {
+        if (blob->hash != hash || blob->size != size)
+            continue;
+        // a text that can not be read is not shared
+        if (!blob->data && load_text(blob) < 0)
+            continue;
+        if (!memcmp(blob->data, text, size))
+            break;
+    }
+
+    if (blob) {
+        blob->refs++;
+        free(packed);
+        if (owned)
+            free(text);
+    } else {
+        blob = malloc(sizeof(Blob));
+        blob->hash = hash;
+        blob->size = size;
+        blob->refs = 1;
+        blob->mark = 0;
+        blob->packed = packed;
+        blob->packed_size = packed_size;
+        blob->packable = !tried || packed;
+        if (packed) {
+            blob->data = NULL;
+            if (owned)
+                free(text);
+            count_packed(blob, 1);
+        } else if (owned) {
+            blob->data = text;
+        } else {
+            blob->data = malloc(size + 1);
+            memcpy(blob->data, text, size);
+            blob->data[size] = '\0';
+        }
+        blob->next = *bucket;
+        *bucket = blob;
+        blob->spill = -1;
+        blob->spill_packed = 0;
+        blob->referenced = 0;
+        ring_insert(blob);
+
+        totals.nr_of_blobs++;
+        totals.stored_bytes += size;
+        totals.resident_bytes += resident_size(blob);
+        enforce_budget(NULL);
+    }
+    totals.nr_of_refs++;
+    totals.logical_bytes += size;
+    pthread_mutex_unlock(&store_lock);
+
+    return blob;
+}
+
+Blob *store_intern(const char *text, size_t size) {
+    return intern((char *)text, size, 0);
+}
+
+// The buffer (of size + 1 bytes, ending with '\0') is taken by the store
+Blob *store_intern_buffer(char *text, size_t size) {
+    return intern(text, size, 1);
+}
+
+void store_retain(Blob *blob) {
+    pthread_mutex_lock(&store_lock);
+    blob->refs++;
+    totals.nr_of_refs++;
+    totals.logical_bytes += blob->size;
+    pthread_mutex_unlock(&store_lock);
+}
+
+// The blob is freed when its last reference is released
+void store_release(Blob *blob) {
+    pthread_mutex_lock(&store_lock);
+    totals.nr_of_refs--;
+    totals.logical_bytes -= blob->size;
+
+    if (--blob->refs == 0) {
+        Blob **link = &buckets[blob->hash & (nr_of_buckets - 1)];
+        while (*link != blob)
+            link = &(*link)->next;
+        *link = blob->next;
+
+        // the space of the spill file is not reused
+        if (blob->data || blob->packed) {
+            ring_remove(blob);
+            totals.resident_bytes -= resident_size(blob);
+        } else {
+            totals.nr_of_spilled--;
+        }
+        if (blob->packed)
+            count_packed(blob, 0);
+        forget_decoded(blob);
+        totals.nr_of_blobs--;
+        totals.stored_bytes -= blob->size;
+        free(blob->data);
+        free(blob->packed);
+        free(blob);
+    }
+    pthread_mutex_unlock(&store_lock);
+}
+
+/*
+* Returns the text of the content, reading it back from the spill file if
+* it was evicted and decoding it if it is compressed. The text stays
+* valid until the next call to the store, which may evict it (or decode
+* another text). Only the main thread reads texts.
+*
+* Returns NULL (with errno set) if the spill file can not be read or the
+* compressed text is corrupt.
+*/
+const char *blob_text(Blob *blob) {
+    blob->referenced = 1;
+    if (blob->data && !blob->packed)
+        return blob->data;
+
+    pthread_mutex_lock(&store_lock);
+    int loaded = 0;
+    if (blob->data)
+        touch_decoded(blob);
+    else
+        loaded = load_text(blob);
+    pthread_mutex_unlock(&store_lock);
+    return loaded < 0 ? NULL : blob->data;
+}
+
+/*
+* Sets the number of bytes of contents that may stay in memory (0 for no
+* limit). The contents over the budget are evicted at once.
+*/
+void store_set_budget(size_t budget) {
+    pthread_mutex_lock(&store_lock);
+    totals.budget = budget;
+    enforce_budget(NULL);
+    pthread_mutex_unlock(&store_lock);
+}
+
+/*
+* Sets the size from which the new contents are compressed (0 to stop
+* compressing, the cold contents too). The contents in memory that reach
+* the size are compressed at once; the ones that are compressed already
+* stay so.
+*/
+void store_set_compression(size_t minSize) {
+    pthread_mutex_lock(&store_lock);
+    totals.compress_min = minSize;
+
+    Blob *blob = tier.hand;
+    if (minSize && blob) {
+        do {
+            if (blob->data && !blob->packed && blob->packable &&
+                blob->size >= minSize && blob->size >= LZ_MIN_SIZE)
+                pack(blob);
+            blob = blob->newer;
+        } while (blob != tier.hand);
+    }
+    pthread_mutex_unlock(&store_lock);
+}
+
+/*
+* Called in a forked child, whose writes to the spill file would overwrite
+* the ones of the parent. The child still reads the spill file, and drops
+* again the contents that it read.
+*/
+void store_fork_child(void) {
+    tier.read_only = 1;
+}
+
+/*
+* Returns a value that was never used as a mark, so a traversal can
+* count every blob only once (by comparing and setting blob->mark).
+*/
+unsigned int store_new_mark(void) {
+    return ++last_mark;
+}
+
+void store_stats(StoreStats *stats) {
+    pthread_mutex_lock(&store_lock);
+    *stats = totals;
+    pthread_mutex_unlock(&store_lock);
+}
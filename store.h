@@ -0,0 +1,71 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct Blob Blob;
+typedef struct StoreStats StoreStats;
+
+/*
+* The text of a file, kept only once for all the files that have the
+* same content. "refs" counts the FileContent structures that use it.
+*
+* A text may be kept compressed ("packed"); then "data" is only a
+* temporary copy, made by blob_text(). Under a memory budget, both are
+* NULL while the text is only in the spill file.
+*/
+struct Blob {
+    uint64_t hash;
+    size_t size;
+    unsigned int refs;
+    unsigned int mark;  // used by the traversals that count every blob once
+    Blob* next;         // next blob from the same bucket
+    char* data;
+    char* packed;
+    size_t packed_size;
+    int packable;       // 0 after a compression that did not pay off
+    Blob* older;        // the CLOCK ring of the blobs that are in memory
+    Blob* newer;
+    int64_t spill;      // offset in the spill file, -1 if never written
+    int spill_packed;   // the spill file keeps the compressed text
+    int referenced;     // read since the CLOCK hand passed last time
+};
+
+struct StoreStats {
+    size_t nr_of_blobs;
+    size_t nr_of_refs;
+    size_t stored_bytes;    // bytes of the distinct contents
+    size_t logical_bytes;   // bytes of all the files, as if not shared
+    size_t budget;          // 0 if the contents are never evicted
+    size_t resident_bytes;  // bytes of the contents that are in memory
+    size_t nr_of_spilled;   // blobs that are only in the spill file
+    size_t spill_bytes;     // size of the spill file
+    size_t nr_of_evictions, nr_of_faults;
+    size_t compress_min;    // 0 if the new contents are not compressed
+    size_t nr_of_packed;    // blobs that are compressed in memory
+    size_t packed_bytes;    // their compressed size
+    size_t unpacked_bytes;  // their real size
+    size_t nr_of_decodes;
+    double decode_ms;
+};
+
+uint64_t store_hash(const char* data, size_t size);
+Blob* store_intern(const char* text, size_t size);
+Blob* store_intern_buffer(char* text, size_t size);
+void store_retain(Blob* blob);
+void store_release(Blob* blob);
+/*
+* The text that blob_text() returns is only valid until the next call to
+* the store (any of these functions, from any thread): it may be evicted
+* under the budget, or its decoded copy may be dropped. A caller that
+* needs it longer has to copy it.
+*/
+const char* blob_text(Blob* blob);
+void store_set_budget(size_t budget);
+void store_set_compression(size_t minSize);
+void store_fork_child(void);
+unsigned int store_new_mark(void);
+void store_stats(StoreStats* stats);
+
+#endif  // STORE_H
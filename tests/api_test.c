@@ -0,0 +1,150 @@
+// Copyright Avram Cristian - Stefan 2022 stefanavram93@gmail.com
+// Copyright Dumitrescu Rares - Matei 2022 mateidum828@gmail.com
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../sdfs.h"
+
+/*
+* Calls the library directly and checks the returned statuses. It also
+* uses the POSIX mkdir() and rmdir(), which the library must not replace.
+*/
+
+#define CHECK(call, expected) check(#call, call, expected, __LINE__)
+
+static int nr_of_failures;
+
+static void check(const char *call, SdfsStatus status, SdfsStatus expected,
+                  int line) {
+    if (status == expected)
+        return;
+    printf("line %d: %s: %s (expected %s)\n", line, call,
+           sdfs_strerror(status), sdfs_strerror(expected));
+    nr_of_failures++;
+}
+
+static int count_node(SdfsNode *node, int depth, void *arg) {
+    (void)node, (void)depth;
+    (*(int *)arg)++;
+    return 0;
+}
+
+static void ignore_result(const char *name, SdfsStatus status, void *arg) {
+    (void)name, (void)status, (void)arg;
+}
+
+static void test_changes(SdfsNode *root) {
+    CHECK(sdfs_mkdir(root, "a"), SDFS_OK);
+    CHECK(sdfs_mkdir(root, "a"), SDFS_EXISTS);
+    CHECK(sdfs_mkdir(root, "x/y"), SDFS_NO_ENTRY);
+    CHECK(sdfs_touch(root, "a/f", "hello", 5), SDFS_OK);
+    CHECK(sdfs_touch(root, "a/f/g", "", 0), SDFS_NOT_DIR);
+    CHECK(sdfs_rm(root, "a"), SDFS_IS_DIR);
+    CHECK(sdfs_rmdir(root, "a"), SDFS_NOT_EMPTY);
+    CHECK(sdfs_rmdir(root, "a/f"), SDFS_NOT_DIR);
+    CHECK(sdfs_ln(root, "a", "b", 0), SDFS_IS_DIR);
+    CHECK(sdfs_ln(root, "a/f", "b", 1), SDFS_OK);
+    CHECK(sdfs_ln(root, "a/f", "b", 1), SDFS_EXISTS);
+    CHECK(sdfs_mv(root, "a", "a"), SDFS_INVALID);
+
+    SdfsNode *file;
+    char text[4];
+    size_t length;
+    CHECK(sdfs_lookup(root, "b", 1, &file), SDFS_OK);
+    CHECK(sdfs_read(file, text, sizeof(text), &length), SDFS_RANGE);
+    if (length != 5) {
+        printf("sdfs_read: length %zu (expected 5)\n", length);
+        nr_of_failures++;
+    }
+
+    // the cwd and its parents are never removed
+    SdfsNode *folder;
+    CHECK(sdfs_mkdir(root, "a/c"), SDFS_OK);
+    CHECK(sdfs_lookup(root, "a/c", 1, &folder), SDFS_OK);
+    CHECK(sdfs_rmrec(folder, "../c"), SDFS_BUSY);
+    CHECK(sdfs_rmrec(folder, "../../a"), SDFS_BUSY);
+
+    CHECK(sdfs_rm(root, "b"), SDFS_OK);
+    CHECK(sdfs_rmrec(root, "a"), SDFS_OK);
+    CHECK(sdfs_lookup(root, "a", 1, &folder), SDFS_NO_ENTRY);
+}
+
+static void test_batch(SdfsNode *root) {
+    const char *paths[] = {"d1", "d2", "d1", "none/d3"};
+    SdfsStatus statuses[4];
+
+    CHECK(sdfs_batch(root, SDFS_MKDIR, paths, 4, NULL, 0, statuses),
+          SDFS_EXISTS);
+    CHECK(statuses[0], SDFS_OK);
+    CHECK(statuses[1], SDFS_OK);
+    CHECK(statuses[2], SDFS_EXISTS);
+    CHECK(statuses[3], SDFS_NO_ENTRY);
+
+    int count = 0;
+    CHECK(sdfs_glob(root, "d*", count_node, &count), SDFS_OK);
+    if (count != 2) {
+        printf("sdfs_glob: %d matches (expected 2)\n", count);
+        nr_of_failures++;
+    }
+
+    CHECK(sdfs_batch(root, SDFS_RMDIR, paths, 2, NULL, 0, statuses),
+          SDFS_OK);
+    CHECK(sdfs_rm_glob(root, "d*", 0, ignore_result, NULL), SDFS_NO_ENTRY);
+}
+
+static void test_transaction(SdfsNode *root) {
+    size_t changes;
+
+    CHECK(sdfs_commit(&root, &changes), SDFS_INVALID);
+    CHECK(sdfs_begin(), SDFS_OK);
+    CHECK(sdfs_begin(), SDFS_BUSY);
+    CHECK(sdfs_mkdir(root, "t"), SDFS_OK);
+    CHECK(sdfs_touch(root, "t/f", "text", 4), SDFS_OK);
+    CHECK(sdfs_abort(&root, &changes), SDFS_OK);
+    if (changes != 2) {
+        printf("sdfs_abort: %zu changes (expected 2)\n", changes);
+        nr_of_failures++;
+    }
+
+    SdfsNode *node;
+    CHECK(sdfs_lookup(root, "t", 1, &node), SDFS_NO_ENTRY);
+}
+
+// The host calls must reach the C library, not the functions of the tree
+static void test_host(void) {
+    char base[] = "/tmp/sdfs_api_XXXXXX", path[sizeof(base) + 4];
+    if (!mkdtemp(base)) {
+        perror("mkdtemp");
+        nr_of_failures++;
+        return;
+    }
+
+    struct stat st;
+    sprintf(path, "%s/sub", base);
+    if (mkdir(path, 0755) < 0 || stat(path, &st) < 0 ||
+        !S_ISDIR(st.st_mode)) {
+        printf("mkdir: '%s' was not created\n", path);
+        nr_of_failures++;
+    }
+    rmdir(path);
+    rmdir(base);
+}
+
+int main(void) {
+    SdfsTree *tree = sdfs_open();
+    SdfsNode *root = sdfs_root(tree);
+
+    test_changes(root);
+    test_batch(root);
+    test_transaction(root);
+    test_host();
+
+    sdfs_close(tree);
+    printf("%s\n", nr_of_failures ? "FAIL tests/api_test.c"
+                                  : "PASS tests/api_test.c");
+    return nr_of_failures != 0;
+}
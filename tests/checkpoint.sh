@@ -0,0 +1,8 @@
+# The archive holds the whole tree, with the links kept as links
+tar -tf _check/ck.tar | sort
+mkdir _check/untar && tar -xf _check/ck.tar -C _check/untar &&
+    for f in a/f a/b/g h; do echo "$f: $(cat _check/untar/root/$f)"; done &&
+    echo "a/l -> $(readlink _check/untar/root/a/l)"
+
+# A path that cannot be created is reported by the background writer
+printf 'checkpoint _check/none/ck.tar\n' | ./sd_fs
@@ -0,0 +1,18 @@
+# The exported tree and archive must be the same as the imported source,
+# with the links kept as links
+diff -r --no-dereference tests/data/tree _check/tree &&
+    echo "export: the directory is the source"
+mkdir _check/untar && tar -xf _check/tree.tar -C _check/untar &&
+    diff -r --no-dereference tests/data/tree _check/untar/tree &&
+    echo "export: the archive is the source"
+tar -tf _check/tree.tar | sort
+tar -tf _check/readme.tar
+
+# An existing host entry of another kind is never written through
+mkdir -p _check/through/tree _check/file/tree _check/stale/tree
+ln -s ../../victim _check/through/tree/notes.txt
+touch _check/file/tree/docs
+ln -s elsewhere _check/stale/tree/link
+printf 'import tests/data/tree\n%s\n%s\n%s\n' 'export tree _check/through' \
+    'export tree _check/file' 'export tree _check/stale' | ./sd_fs
+test ! -e _check/victim && echo "export: the link was not followed"
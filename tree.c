@@ -1,15 +1,19 @@
 // Copyright Avram Cristian - Stefan 2022 stefanavram93@gmail.com
 // Copyright Dumitrescu Rares - Matei 2022 mateidum828@gmail.com
 
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "tree.h"
-#define TREE_CMD_INDENT_SIZE 4
-#define NO_ARG ""
-#define PARENT_DIR ".."
-#define TAB_SIZE 4
+#include "index.h"
+#include "pattern.h"
+#include "search.h"
+#include "undo.h"
+#include "watch.h"
 
+static unsigned int last_node_id;
+
+// changed by every change of the tree, so the cached links are refreshed
+static unsigned long tree_version;
 
 /*
 * Function used to create FileTree, with root pointer initialized to
@@ -19,6 +23,7 @@
 FileTree createFileTree(char* rootFolderName) {
     TreeNode *current_dir = malloc(sizeof(TreeNode));
     current_dir->parent = NULL;
+    current_dir->id = 0;
     current_dir->name = malloc(strlen(rootFolderName) + 1);
     memcpy(current_dir->name, rootFolderName, strlen(rootFolderName) + 1);
     current_dir->type = FOLDER_NODE;
@@ -45,8 +50,25 @@ void freeTree(FileTree fileTree) {
 
     if (current_root->type == FILE_NODE) {
         FileContent *file_content = (FileContent *)current_root->content;
-        free(file_content->text);
-        free(file_content);
+        search_remove(current_root);
+
+        // the content is freed together with its last hard link
+        if (file_content->nodes) {
+            unsigned int i = 0;
+            while (file_content->nodes[i] != current_root)
+                i++;
+            file_content->nodes[i] =
+                file_content->nodes[file_content->links - 1];
+        }
+        if (--file_content->links == 0) {
+            store_release(file_content->body);
+            free(file_content->nodes);
+            free(file_content);
+        }
+    } else if (current_root->type == SYMLINK_NODE) {
+        LinkContent *link_content = (LinkContent *)current_root->content;
+        free(link_content->target);
+        free(link_content);
     } else {
         FolderContent *dir_content = (FolderContent *)current_root->content;
 
@@ -61,6 +83,7 @@ void freeTree(FileTree fileTree) {
                 freeTree(new_root);
                 free(prev);
             }
+            index_free(dir_content->index);
             free(dir_content->children);
             free(dir_content);
         }
@@ -70,792 +93,1078 @@ void freeTree(FileTree fileTree) {
 }
 
 /*
-* This is a recursive function. It is first called from "ls" function.
-*
-* It is used for printing the children of a given FolderNode.
-*
-* It is printing in reverse, from the last added node to the first one.
-*
-* The data from the current node is being pushed on stack as the
-* traversing of the parent node's children continues.
+* Returns the content of a folder. An empty folder has no content, so
+* it is created when the first child is added.
 */
-void print_ls(ListNode *content_node, int do_not_print_newline) {
-    if (!content_node)
-        return;
-
-    print_ls(content_node->next, 0);
-    TreeNode *info = content_node->info;
-    printf("%s", info->name);
-    if (do_not_print_newline)
-        return;
-    printf("\n");
+static FolderContent *folder_content(TreeNode *folder) {
+    if (folder->content == NULL) {
+        FolderContent *directory_content = malloc(sizeof(FolderContent));
+        directory_content->children = malloc(sizeof(List));
+        directory_content->children->head = NULL;
+        directory_content->children->tail = NULL;
+        directory_content->index = NULL;
+        folder->content = directory_content;
+    }
+    return folder->content;
 }
 
-
 /*
-* If the current node is a directory, this function will proceed
-* to print the elements that this folder contains.
-*
-* In case of being a text file, this function will print its content.
+* Searches a child by its name. If "prev" is given, it will point to
+* the list node placed before the child (NULL if the child is the head).
 */
-void ls(TreeNode* currentNode, char* arg) {
-    if (currentNode->content == NULL)
-        return;
-
-    if (strlen(arg) == 0) {
-        FolderContent *directory_content =
-        (FolderContent *)currentNode->content;
+ListNode *find_child(TreeNode *folder, const char *name, ListNode **prev) {
+    FolderContent *directory_content = (FolderContent *)folder->content;
+    if (prev)
+        *prev = NULL;
+    if (!directory_content)
+        return NULL;
+
+    ListNode *content_node = directory_content->children->head;
+    while (content_node) {
+        if (!strcmp(content_node->info->name, name))
+            return content_node;
+        if (prev)
+            *prev = content_node;
+        content_node = content_node->next;
+    }
+    return NULL;
+}
 
-        ListNode *content_node = directory_content->children->head;
+TreeNode *new_node(const char *name, enum TreeNodeType type,
+                   void *content) {
+    TreeNode *info = malloc(sizeof(TreeNode));
+    info->parent = NULL;
+    // the import threads are creating nodes at the same time
+    info->id = __atomic_add_fetch(&last_node_id, 1, __ATOMIC_RELAXED);
+    info->name = malloc(strlen(name) + 1);
+    memcpy(info->name, name, strlen(name) + 1);
+    info->type = type;
+    info->content = content;
+    return info;
+}
 
-        print_ls(content_node, 1);
-    } else {
-        FolderContent *directory_content =
-        (FolderContent *)currentNode->content;
-        ListNode *content_node = directory_content->children->head;
+// The new content takes the reference to "body" that the caller holds
+FileContent *new_file_content(Blob *body) {
+    FileContent *file_content = malloc(sizeof(FileContent));
+    file_content->body = body;
+    file_content->links = 1;
+    file_content->nodes = NULL;
+    return file_content;
+}
 
-        while (content_node) {
-            TreeNode *info = content_node->info;
-            if (strcmp(arg, info->name) == 0) {
-                if (info->type == FOLDER_NODE) {
-                    ls(info, "\0");
-                } else {
-                    FileContent *file_content = (FileContent *)info->content;
-                    printf("%s: %s\n", info->name, file_content->text);
-                }
-                return;
-            }
-            content_node = content_node->next;
-        }
+LinkContent *new_link_content(const char *target) {
+    LinkContent *link_content = malloc(sizeof(LinkContent));
+    link_content->target = malloc(strlen(target) + 1);
+    memcpy(link_content->target, target, strlen(target) + 1);
+    link_content->cache = NULL;
+    link_content->hops = 0;
+    // the version of the tree is never 0 after the link is added
+    link_content->version = 0;
+    return link_content;
+}
 
-        printf("ls: cannot access '%s': No such file or directory", arg);
-    }
+// Every cached link target is refreshed after this call
+void tree_changed(void) {
+    tree_version++;
 }
 
 /*
-* This function prints the path from root to the current directory.
-*
-* It is traversing the nodes through the parents and it is storing
-* their names in an array of char* (dir_names).
+* Links the list node after "prev" (or as the head, if prev is NULL).
+* Every node that enters a folder is linked through this function,
+* so the sorted index of the folder (if it was built) stays updated.
 */
-void pwd(TreeNode* treeNode) {
-    if (treeNode->parent == NULL) {
-        printf("root\n");
-        return;
+void link_child(TreeNode *folder, ListNode *prev, ListNode *child) {
+    FolderContent *directory_content = folder_content(folder);
+    List *children = directory_content->children;
+    child->info->parent = folder;
+    tree_changed();
+
+    if (prev) {
+        child->next = prev->next;
+        prev->next = child;
+    } else {
+        child->next = children->head;
+        children->head = child;
     }
+    if (children->tail == prev)
+        children->tail = child;
 
-    char **dir_names;  // used to store the names of all directories
-    TreeNode *current_dir = treeNode;
-    int index = 0, size = 0;
-    while (current_dir != NULL) {
-        if (!size) {
-            dir_names = malloc(sizeof(char *));
-            size = 1;
-        } else if (index == size) {
-            size *= 2;
-            dir_names = realloc(dir_names, size * sizeof(char *));
-        }
-        dir_names[index] = malloc(strlen(current_dir->name) + 1);
-        memcpy(dir_names[index], current_dir->name,
-               strlen(current_dir->name) + 1);
-        index++;
-        current_dir = current_dir->parent;
-    }
-    for (int i = index - 1; i >= 0; i--) {
-        printf("%s", dir_names[i]);  // printing names to create path
-        free(dir_names[i]);
+    if (directory_content->index)
+        index_insert(directory_content->index, child->info);
+}
 
-        if (i > 0)
-            printf("/");  // delimiter for path
-    }
-    free(dir_names);
+void append_child(TreeNode *folder, TreeNode *node) {
+    ListNode *new_content_node = malloc(sizeof(ListNode));
+    new_content_node->info = node;
+    ListNode *tail = folder_content(folder)->children->tail;
+
+    // a node without a parent was created by the current command
+    int created = node->parent == NULL;
+    link_child(folder, tail, new_content_node);
+    undo_link(folder, tail, new_content_node, created);
+    watch_publish(created ? WATCH_CREATE : WATCH_MOVED_TO, node, folder);
 }
 
 /*
-* A function used to change path from the current node, depending on the
-* argument.
-*
-* The char* path is splitted by "/" delimiter, using strtok.
-* The children are being traversed by verifying the corespondency
-* between their names and the current token.
-*
-* This function may get more options (1, 2, 3).
-* Option 1 -> main functionality on *cd* command;
-* Option 2 -> called in *cp* for verifying the destination node;
-*          -> also called in *mv* for both source and destination nodes;
-*          -> if path isn't correct, it is going to return NULL;
-* Option 3 -> used in *cp* for source node.
+* Takes the list node out of its folder, without freeing anything.
+* A folder that remains without children gets back a NULL content.
 */
-TreeNode* cd(TreeNode* currentNode, char* path, int option) {
-    TreeNode *initial_copy_current = currentNode, *copy = currentNode;
+void detach_child(TreeNode *folder, ListNode *prev, ListNode *child) {
+    FolderContent *directory_content = (FolderContent *)folder->content;
+    tree_changed();
+
+    if (prev)
+        prev->next = child->next;
+    else
+        directory_content->children->head = child->next;
+    if (directory_content->children->tail == child)
+        directory_content->children->tail = prev;
+
+    if (directory_content->index)
+        index_remove(directory_content->index, child->info);
+
+    if (directory_content->children->head == NULL) {
+        index_free(directory_content->index);
+        free(directory_content->children);
+        free(directory_content);
+        folder->content = NULL;
+    }
+}
 
-    char *token = strtok(path, "/");
+/*
+* Takes the child out of its folder and returns it, without freeing it.
+* During a transaction, the list node is kept by the undo log. "event"
+* tells the watches if the child is removed or moved.
+*/
+static TreeNode *unlink_child(TreeNode *folder, ListNode *prev,
+                              ListNode *child, int event) {
+    TreeNode *info = child->info;
+
+    watch_publish(event, info, folder);
+    detach_child(folder, prev, child);
+    if (!undo_unlink(folder, prev, child))
+        free(child);
+    return info;
+}
 
-    while (token != NULL) {
-        if (strcmp(token, "..") == 0) {
-            copy = copy->parent;
-        } else {
-            FolderContent *content = (FolderContent *)copy->content;
-            if (!content) {
-                if (option == 1) {
-                    printf("cd: no such file or directory: %s", path);
-                    return initial_copy_current;
-                } else if (option == 2) {
-                    return NULL;
-                }
-            }
+// During a transaction, the node is only freed by *commit*
+void free_node(TreeNode *node) {
+    if (undo_free(node))
+        return;
 
-            List *my_list = content->children;
-            ListNode *current_file = my_list->head;
-            while (current_file != NULL) {
-                if (strcmp(token, current_file->info->name) == 0 &&
-                    current_file->info->type == FOLDER_NODE && option != 3) {
-                    copy = current_file->info;
-                    break;
-                } else if (strcmp(token, current_file->info->name) == 0 &&
-                    current_file->info->type != FOLDER_NODE) {
-                    if (option == 1) {
-                        printf("cd: no such file or directory: %s", path);
-                    } else {
-                        copy = current_file->info;
-                        break;
-                    }
-                    return initial_copy_current;
-                }
-                current_file = current_file->next;
-            }
+    FileTree root;
+    root.root = node;
+    freeTree(root);
+}
 
-            if (current_file == NULL) {
-                if (option == 1) {
-                    printf("cd: no such file or directory: %s", path);
-                } else if (option == 2) {
-                    return NULL;
-                }
-                return initial_copy_current;
-            }
-        }
-        token = strtok(NULL, "/");
+/*
+* Tells if the node is the current folder or one of its ancestors. Such
+* a node is never removed, as the current folder would be freed with it.
+*/
+static int in_use(TreeNode *node, TreeNode *currentNode) {
+    for (; currentNode; currentNode = currentNode->parent) {
+        if (currentNode == node)
+            return 1;
     }
-    return copy;
+    return 0;
 }
 
+static TreeNode *lookup(TreeNode *currentNode, const char *path,
+                        int follow, int *hops);
+
 /*
-* This is a recursive function that takes every directory
-* and prints its elements in reverse order.
-*
-* It actually pushes the current data on stack and goes
-* forward to the next element, so the data is printed
-* in reverse order.
+* Follows a chain of symbolic links until a file or a folder is found.
+* Returns NULL if a target does not exist, or if more than LINK_MAX_HOPS
+* links are followed (so a cycle of links always ends).
 *
-* The "distance" variable represents the distance
-* between the initial parent node and the current node and
-* it is used for assign the number of tabs that needs to be printed. 
+* "hops" is shared by the nested lookups of the same resolution, which
+* only read the cached targets; the cache is written by resolve_link.
 */
-void print_tree(ListNode *content_node, int distance,
-                int *nr_of_dir, int *nr_of_files) {
-    if (!content_node)
-        return;
-
-    char *distance_string;
-    char *pula = "\t";
-    if (!distance) {
-        distance_string = "";
-    } else {
-        distance_string = malloc(TAB_SIZE * distance);
-        for (int i = 0; i < distance; i++) {
-            memcpy(distance_string + i, "\t", TAB_SIZE);
-        }
+static TreeNode *follow_link(TreeNode *node, int *hops) {
+    while (node && node->type == SYMLINK_NODE) {
+        LinkContent *link_content = (LinkContent *)node->content;
+        int cached = link_content->version == tree_version;
+
+        // a cached target costs the links that were followed to find it
+        *hops += cached ? link_content->hops : 1;
+        if (*hops > LINK_MAX_HOPS)
+            return NULL;
+
+        if (cached)
+            node = link_content->cache;
+        else
+            node = lookup(node->parent, link_content->target, 0, hops);
     }
+    return node;
+}
 
-    print_tree(content_node->next, distance, nr_of_dir, nr_of_files);
-    if (content_node->info->type == FOLDER_NODE) {
-        (*nr_of_dir)++;
-        printf("%s%s\n", distance_string, content_node->info->name);
-
-        FolderContent *dir_content = content_node->info->content;
-        if (dir_content == NULL) {
-            if (distance)
-                free(distance_string);
-            return;
-        }
-
-        ListNode *current_node = dir_content->children->head;
-        print_tree(current_node, distance + 1, nr_of_dir, nr_of_files);
-    } else {
-        (*nr_of_files)++;
-        printf("%s%s\n", distance_string, content_node->info->name);
+/*
+* Returns the node that a symbolic link points to (or the node itself,
+* if it is not a link). The result stays cached in the link until the
+* tree changes again, so a path that goes through the same link many
+* times resolves it only once.
+*/
+TreeNode *resolve_link(TreeNode *node) {
+    if (node->type != SYMLINK_NODE)
+        return node;
+
+    LinkContent *link_content = (LinkContent *)node->content;
+    if (link_content->version != tree_version) {
+        int hops = 0;
+        link_content->cache = follow_link(node, &hops);
+        link_content->hops = hops;
+        link_content->version = tree_version;
     }
-    if (distance)
-        free(distance_string);
+    return link_content->cache;
 }
 
 /*
-* This function works somehow like *ls*.
-*
-* The char* path is splitted by "/" delimiter, using strtok.
-* The children are being traversed by verifying the corespondency
-* between their names and the current token.
+* Walks the path from the current node. The links found on the way are
+* followed; the last component is followed only if "follow" is set.
+* Without "hops", this is a new resolution, so resolve_link is used.
 */
-void tree(TreeNode* currentNode, char* arg) {
-    int nr_of_dir = 0, nr_of_files = 0;
-
-    if (strlen(arg) == 0) {
-        FolderContent *directory_content =
-        (FolderContent *)currentNode->content;
-        ListNode *content_node = directory_content->children->head;
-
-        print_tree(content_node, 0, &nr_of_dir, &nr_of_files);
-    } else {
-        char *token = strtok(arg, "/");
-        TreeNode *copy = currentNode;
-
-        while (token != NULL) {
-            if (strcmp(token, "..") == 0) {
-                copy = copy->parent;
-            } else {
-                FolderContent *content = (FolderContent *)copy->content;
-                if (content == NULL) {
-                    printf("%s [error opening dir]\n\n0 directories, 0 files\n",
-                           arg);
-                    return;
-                }
-
-                List *my_list = content->children;
-                ListNode *current_file = my_list->head;
-                while (current_file != NULL) {
-                    if (strcmp(token, current_file->info->name) == 0 &&
-                        current_file->info->type == FOLDER_NODE) {
-                        currentNode = current_file->info;
-                        break;
-                    } else if (strcmp(token, current_file->info->name) == 0 &&
-                        current_file->info->type != FOLDER_NODE) {
-                        printf(
-                        "%s [error opening dir]\n\n0 directories, 0 files\n",
-                        arg);
-                        return;
-                    }
-                    current_file = current_file->next;
-                }
-
-                if (current_file == NULL) {
-                    printf(
-                        "%s [error opening dir]\n\n0 directories, 0 files\n",
-                        arg);
-                    return;
-                }
-                copy = current_file->info;
-            }
-        token = strtok(NULL, "/");
+static TreeNode *lookup(TreeNode *currentNode, const char *path,
+                        int follow, int *hops) {
+    char *copy_path = malloc(strlen(path) + 1);
+    memcpy(copy_path, path, strlen(path) + 1);
+
+    TreeNode *node = currentNode;
+    char *token = copy_path;
+    while (node && *token) {
+        // the components are split by hand, as lookups may be nested
+        char *rest = token + strcspn(token, "/");
+        if (*rest)
+            *rest++ = '\0';
+        while (*rest == '/')
+            rest++;
+
+        if (strcmp(token, PARENT_DIR) == 0) {
+            if (node->parent)
+                node = node->parent;
+        } else if (*token && strcmp(token, ".") != 0) {
+            ListNode *child = NULL;
+            if (node->type == FOLDER_NODE)
+                child = find_child(node, token, NULL);
+            node = child ? child->info : NULL;
+
+            if (node && node->type == SYMLINK_NODE && (*rest || follow))
+                node = hops ? follow_link(node, hops) : resolve_link(node);
         }
-        FolderContent *directory_content = (FolderContent *)copy->content;
-        ListNode *content_node = directory_content->children->head;
-
-        print_tree(content_node, 0, &nr_of_dir, &nr_of_files);
+        token = rest;
     }
 
-    printf("%d directories, %d files\n", nr_of_dir, nr_of_files);
+    free(copy_path);
+    return node;
 }
 
 /*
-* This function creates a directory that is added to the tail
-* of the currentNode's children list.
-*
-* It creates a TreeNode* that is a type of FOLDER_NODE, and its
-* void* content pointer is redirecting to FolderContent.
+* Walks the given path from the current node, without printing anything.
+* Returns NULL if a component is missing or if a file is used as a folder.
 */
-void mkdir(TreeNode* currentNode, char* folderName) {
-    ListNode *new_content_node;  // content of new directory
+TreeNode *walk_path(TreeNode *currentNode, const char *path) {
+    return lookup(currentNode, path, 1, NULL);
+}
 
-    if (currentNode->content == NULL) {
-        FolderContent *directory_content = malloc(sizeof(FolderContent));
-        currentNode->content = directory_content;
+// The same walk, but a link at the end of the path is returned itself
+TreeNode *lookup_path(TreeNode *currentNode, const char *path, int follow) {
+    return lookup(currentNode, path, follow, NULL);
+}
 
-        List *dir_content_head = malloc(sizeof(List));
-        directory_content->children = dir_content_head;
+/*
+* Returns the sorted index of a folder. The index is built only when
+* a sorted view is needed for the first time; after that, it is updated
+* with every node that is added or removed.
+*/
+NameIndex *folder_index(TreeNode *folder) {
+    FolderContent *directory_content = (FolderContent *)folder->content;
+    if (!directory_content)
+        return NULL;
 
-        new_content_node = malloc(sizeof(ListNode));
-        dir_content_head->head = new_content_node;
-    } else {
-        FolderContent *directory_content =
-        (FolderContent *)currentNode->content;
+    if (!directory_content->index) {
+        directory_content->index = index_create();
         ListNode *content_node = directory_content->children->head;
-        ListNode *prev;
-
-        while (content_node != NULL) {
-            if (!strcmp(content_node->info->name, folderName)) {
-                printf(
-                "mkdir: cannot create directory '%s': File exists",
-                folderName);
-                return;
-            }
-
-            prev = content_node;
+        while (content_node) {
+            index_insert(directory_content->index, content_node->info);
             content_node = content_node->next;
         }
+    }
+    return directory_content->index;
+}
 
-        new_content_node = malloc(sizeof(ListNode));
-        prev->next = new_content_node;
+/*
+* Writes the path of a node ("root/dir/file") in a buffer of "size"
+* bytes, like snprintf: the path is written only if it fits together
+* with its terminator. Returns the length of the path.
+*
+* The names are copied from the node up to the root, from the end of
+* the buffer, so the tree is walked only twice and nothing is allocated.
+*/
+size_t node_path(const TreeNode *node, char *buffer, size_t size) {
+    size_t length = 0;
+    for (const TreeNode *dir = node; dir; dir = dir->parent)
+        length += strlen(dir->name) + (dir->parent ? 1 : 0);
+    if (length >= size)
+        return length;
+
+    size_t end = length;
+    buffer[end] = '\0';
+    for (const TreeNode *dir = node; dir; dir = dir->parent) {
+        size_t name_len = strlen(dir->name);
+        end -= name_len;
+        memcpy(buffer + end, dir->name, name_len);
+        if (dir->parent)
+            buffer[--end] = '/';  // delimiter for path
     }
+    return length;
+}
 
-    new_content_node->next = NULL;
+/*
+* Adds the files of a subtree to the counters of *du*. A text that is
+* shared by more files is added to "stored" only once, as its blob is
+* marked the first time it is found.
+*/
+static void du_walk(TreeNode *node, unsigned int mark, int *nr_of_files,
+                    size_t *logical, size_t *stored) {
+    if (node->type == FILE_NODE) {
+        Blob *body = ((FileContent *)node->content)->body;
+        (*nr_of_files)++;
+        *logical += body->size;
+        if (body->mark != mark) {
+            body->mark = mark;
+            *stored += body->size;
+        }
+        return;
+    }
 
-    TreeNode *info = malloc(sizeof(TreeNode));
+    // the symbolic links are not followed, so a cycle is never walked
+    FolderContent *directory_content = (FolderContent *)node->content;
+    if (node->type != FOLDER_NODE || !directory_content)
+        return;
 
-    info->parent = currentNode;
-    info->name = malloc(strlen(folderName) + 1);
-    memcpy(info->name, folderName, strlen(folderName) + 1);
-    info->type = FOLDER_NODE;
+    for (ListNode *child = directory_content->children->head; child;
+         child = child->next)
+        du_walk(child->info, mark, nr_of_files, logical, stored);
+}
 
-    info->content = NULL;
-    new_content_node->info = info;
+/*
+* Counts the files of a subtree, the size of their texts and the size
+* of the distinct texts among them, as they are kept by the store.
+*/
+void disk_usage(TreeNode *node, int *nr_of_files, size_t *logical,
+                size_t *stored) {
+    *nr_of_files = 0;
+    *logical = *stored = 0;
+    du_walk(node, store_new_mark(), nr_of_files, logical, stored);
 }
 
 /*
-* Function that deletes recursively both directories and files.
-* If the current node is going to be a FolderNode, then this function
-* is going to be called again, to delete this new folder's elements and so on.
+* The commands that create or remove nodes accept many targets at once.
+* Every target may be a path; the targets are grouped by their parent
+* folder, every parent is walked only once and its children are scanned
+* only once for the whole group. The statuses are given at the end, in
+* the order of the targets, just like the commands were given one by one.
+* The targets are handled one by one, in their order, when this can not
+* give the same result: a path that goes through ".." or through a link,
+* or a target inside another target.
 */
-void rmrec(TreeNode* currentNode, char* resourceName) {
-    FolderContent *content = (FolderContent *)currentNode->content;
-    if (!content)
-        return;
+// smaller groups compare the names directly, without hashing them
+#define BATCH_MIN_SET 8
+
+typedef struct BatchTarget BatchTarget;
+typedef struct NameSet NameSet;
+
+struct BatchTarget {
+    const char *path;  // the argument, as it was given
+    char *parent;      // the folder part, without "." and empty components
+    char *full;        // the whole path, normalized in the same way
+    char *name;        // the last component (placed inside "full")
+    int first;         // the first target with the same path, or -1
+    int found;
+    int status;
+};
+
+// Open addressing table of names, each one with an integer value
+struct NameSet {
+    const char **names;
+    int *values;
+    size_t mask, size;
+};
+
+static void name_set_init(NameSet *set, size_t count) {
+    size_t capacity = 16;
+    while (capacity < 2 * count)
+        capacity *= 2;
+    set->names = calloc(capacity, sizeof(char *));
+    set->values = malloc(capacity * sizeof(int));
+    set->mask = capacity - 1;
+    set->size = 0;
+}
 
-    List *file_list = content->children;
-    // getting the list of files in the directory
-    ListNode *current_file = file_list->head;
-    ListNode *prev_file = current_file;
+static void name_set_free(NameSet *set) {
+    free(set->names);
+    free(set->values);
+}
 
-    while (current_file != NULL) {
-        if (strcmp(current_file->info->name, resourceName) == 0) {
-            // found the directory or file to delete
-            break;
-        }
-        prev_file = current_file;
-        current_file = current_file->next;
-    }
+static size_t name_set_slot(NameSet *set, const char *name) {
+    size_t slot = store_hash(name, strlen(name)) & set->mask;
+    while (set->names[slot] && strcmp(set->names[slot], name))
+        slot = (slot + 1) & set->mask;
+    return slot;
+}
 
-    if (current_file == NULL) {
-        printf("rmrec: failed to remove '%s': No such file or directory\n",
-               resourceName);
-        return;
-    }
-    // if directory or file was found list of children must change
-    // and get the file out of it
+// Returns the value of the name, or -1 if the name is not in the set
+static int name_set_find(NameSet *set, const char *name) {
+    size_t slot = name_set_slot(set, name);
+    return set->names[slot] ? set->values[slot] : -1;
+}
 
-    // there are several possible options to check first:
-    if (current_file == file_list->head) {
-        if (current_file->info->type == FILE_NODE) {
-            file_list->head = current_file->next;
+static void name_set_add(NameSet *set, const char *name, int value) {
+    if (2 * (set->size + 1) > set->mask + 1) {
+        NameSet bigger;
+        name_set_init(&bigger, set->mask + 1);
+        for (size_t i = 0; i <= set->mask; i++) {
+            if (set->names[i])
+                name_set_add(&bigger, set->names[i], set->values[i]);
+        }
+        name_set_free(set);
+        *set = bigger;
+    }
 
-            FileContent *file_content = file_list->head->info->content;
-            if (file_content)
-                free(file_content->text);
+    size_t slot = name_set_slot(set, name);
+    if (!set->names[slot])
+        set->size++;
+    set->names[slot] = name;
+    set->values[slot] = value;
+}
 
-            free(current_file->info->name);
-            free(current_file->info);
-            free(current_file);
-            return;
-        } else {
-            file_list->head = current_file->next;
-            FileTree root;
-            root.root = current_file->info;
-            freeTree(root);
-            free(current_file);
-            return;
-        }
+/*
+* Splits a target in its normalized parent and name. Returns 0 if the
+* path goes up through "..", as such paths can not be grouped safely.
+*/
+static int split_target(BatchTarget *target, const char *path) {
+    size_t len = strlen(path);
+    int simple = 1;
+
+    target->path = path;
+    target->full = malloc(len + 1);
+    target->parent = malloc(len + 1);
+    target->full[0] = target->parent[0] = '\0';
+
+    char *copy_path = malloc(len + 1);
+    memcpy(copy_path, path, len + 1);
+
+    size_t full_len = 0, last = 0;
+    for (char *token = strtok(copy_path, "/"); token;
+         token = strtok(NULL, "/")) {
+        if (!strcmp(token, "."))
+            continue;
+        if (!strcmp(token, PARENT_DIR))
+            simple = 0;
+        if (full_len)
+            target->full[full_len++] = '/';
+        last = full_len;
+        memcpy(target->full + full_len, token, strlen(token) + 1);
+        full_len += strlen(token);
     }
+    free(copy_path);
+
+    memcpy(target->parent, target->full, last ? last - 1 : 0);
+    target->parent[last ? last - 1 : 0] = '\0';
+    target->name = target->full + last;
+    target->first = -1;
+    target->found = 0;
+    target->status = STATUS_OK;
+    return simple;
+}
 
-    prev_file->next = current_file->next;
-    if (current_file->info->type == FILE_NODE) {
-        FileContent *file_content = current_file->info->content;
-        if (file_content)
-            free(file_content->text);
+static int compare_targets(const void *a, const void *b) {
+    const BatchTarget *x = *(BatchTarget * const *)a;
+    const BatchTarget *y = *(BatchTarget * const *)b;
+    int result = strcmp(x->parent, y->parent);
+    if (result)
+        return result;
+    return (x > y) - (x < y);
+}
 
-        free(current_file->info->name);
-        free(current_file->info);
-        free(current_file);
-        return;
+// First position in the sorted array that is not smaller than the key
+static int lower_bound(BatchTarget **sorted, int count, const char *key) {
+    int left = 0, right = count;
+    while (left < right) {
+        int middle = (left + right) / 2;
+        if (strcmp(sorted[middle]->parent, key) < 0)
+            left = middle + 1;
+        else
+            right = middle;
     }
-    FileTree root;
-    root.root = current_file->info;
-    freeTree(root);
-    free(current_file);
+    return left;
 }
 
 /*
-* Function that is used to delete a file.
-* As a fileis one of its parent's children, the linkings
-* between the previous and next children have to be modified.
+* The groups may be handled in any order only if no target is the parent
+* (or an ancestor) of the other targets, like in "mkdir a a/b".
 */
-void rm(TreeNode* currentNode, char* fileName) {
-    FolderContent *content = (FolderContent *)currentNode->content;
-
-    List *file_list = content->children;  // list of files in the directory
-    ListNode *current_file = file_list->head;
-    ListNode *prev_file = current_file;
-
-    while (current_file != NULL) {
-        if (strcmp(current_file->info->name, fileName) == 0) {
-            // found the file to delete
-            break;
+static int targets_independent(BatchTarget **sorted, int count) {
+    for (int i = 0; i < count; i++) {
+        const char *full = sorted[i]->full;
+        size_t len = strlen(full);
+
+        int position = lower_bound(sorted, count, full);
+        for (; position < count; position++) {
+            const char *parent = sorted[position]->parent;
+            if (strncmp(parent, full, len))
+                break;
+            if (parent[len] == '\0' || parent[len] == '/')
+                return 0;
         }
-        prev_file = current_file;
-        current_file = current_file->next;
     }
+    return 1;
+}
 
-    if (current_file == NULL) {
-        printf("rm: failed to remove '%s': No such file or directory\n",
-               fileName);
-        return;
+/*
+* Tells if the folders of a normalized parent path go through a symbolic
+* link. Without links, two different parents always name two different
+* folders, so grouping the targets by their parent path is the same as
+* grouping them by the folder; with links, "l/x" and "b/x" may name the
+* same node, or one target may create the folder of another one.
+*/
+static int parent_has_link(TreeNode *currentNode, const char *parent) {
+    char *copy_parent = malloc(strlen(parent) + 1);
+    memcpy(copy_parent, parent, strlen(parent) + 1);
+
+    TreeNode *folder = currentNode;
+    int found = 0;
+    for (char *token = strtok(copy_parent, "/"); token && !found;
+         token = strtok(NULL, "/")) {
+        ListNode *child = find_child(folder, token, NULL);
+        if (!child)
+            break;
+        folder = child->info;
+        if (folder->type == SYMLINK_NODE)
+            found = 1;
+        else if (folder->type != FOLDER_NODE)
+            break;
     }
+    free(copy_parent);
+    return found;
+}
 
-    if (current_file->info->type != FILE_NODE) {
-        printf("rm: cannot remove '%s': Is a directory\n",
-                fileName);
-        return;
+/*
+* Creates the new nodes of a group. The names of the existing children
+* are put in a set during a single pass, so every target is checked
+* without scanning the list again (small groups just search the list).
+*/
+static void create_group(TreeNode *folder, BatchTarget **group, int count,
+                         int kind, Blob *body) {
+    NameSet set;
+    name_set_init(&set, count);
+
+    FolderContent *directory_content = (FolderContent *)folder->content;
+    if (directory_content && count >= BATCH_MIN_SET) {
+        for (ListNode *child = directory_content->children->head; child;
+             child = child->next)
+            name_set_add(&set, child->info->name, 0);
     }
-    // if it is a file to delete and not a directory it will be deleted
 
-    if (current_file == file_list->head) {
-        file_list->head = current_file->next;
-    } else {
-        prev_file->next = current_file->next;
+    for (int i = 0; i < count; i++) {
+        int exists = count >= BATCH_MIN_SET
+                     ? name_set_find(&set, group[i]->name) >= 0
+                     : find_child(folder, group[i]->name, NULL) != NULL;
+        if (exists) {
+            group[i]->status = STATUS_EXISTS;
+            continue;
+        }
+
+        TreeNode *info;
+        if (kind == BATCH_MKDIR) {
+            info = new_node(group[i]->name, FOLDER_NODE, NULL);
+        } else {
+            store_retain(body);
+            info = new_node(group[i]->name, FILE_NODE,
+                            new_file_content(body));
+        }
+        append_child(folder, info);
+        search_add(info);
+        if (count >= BATCH_MIN_SET)
+            name_set_add(&set, info->name, 0);
     }
+    name_set_free(&set);
+}
 
-    FileContent *file_content = file_list->head->info->content;
-    if (file_content)
-        free(file_content->text);
+// Returns the first target of the group with the given name, or -1
+static int find_target(NameSet *set, BatchTarget **group, int count,
+                       const char *name) {
+    if (count >= BATCH_MIN_SET)
+        return name_set_find(set, name);
 
-    free(current_file->info->name);
-    free(current_file->info);
-    free(current_file);
+    for (int i = 0; i < count; i++) {
+        if (group[i]->first < 0 && !strcmp(group[i]->name, name))
+            return i;
+    }
+    return -1;
 }
 
 /*
-* Function that deletes an empty directory.
-* As a directory is one of its parent's children, the linkings
-* between the previous and next children have to be modified.
+* Removes the targets of a group during a single pass over the children.
+* A target that is given again gets the result that it would have got
+* after its first appearance.
 */
-void rmdir(TreeNode* currentNode, char* folderName) {
-    FolderContent *content = (FolderContent *)currentNode->content;
-    List *file_list = content->children;  // list of files in the directory
-    ListNode *current_file = file_list->head;
-    ListNode *prev_file = current_file;
-    while (current_file != NULL) {
-        if (strcmp(folderName, current_file->info->name) == 0) {
-            // found the directory to delete
-            break;
-        }
-        prev_file = current_file;
-        current_file = current_file->next;
+static void remove_group(TreeNode *currentNode, TreeNode *folder,
+                         BatchTarget **group, int count, int kind) {
+    NameSet set;
+    name_set_init(&set, count);
+
+    for (int i = 0; i < count; i++) {
+        int first = name_set_find(&set, group[i]->name);
+        if (first >= 0)
+            group[i]->first = first;
+        else
+            name_set_add(&set, group[i]->name, i);
     }
 
-    if (current_file == NULL) {
-        printf("rmdir: failed to remove '%s': No such file or directory\n",
-               folderName);
-        return;
-    }
+    ListNode *prev = NULL, *child = NULL, *next;
+    if (folder->content)
+        child = ((FolderContent *)folder->content)->children->head;
 
-    if (current_file->info->type != FOLDER_NODE) {
-        printf("rmdir: failed to remove '%s': Not a directory\n",
-               folderName);
-        return;
+    for (; child; child = next) {
+        next = child->next;
+        int i = find_target(&set, group, count, child->info->name);
+        if (i < 0) {
+            prev = child;
+            continue;
+        }
+
+        TreeNode *info = child->info;
+        group[i]->found = 1;
+        if (kind == BATCH_RM && info->type == FOLDER_NODE)
+            group[i]->status = STATUS_IS_DIR;
+        else if (kind == BATCH_RMDIR && info->type != FOLDER_NODE)
+            group[i]->status = STATUS_NOT_DIR;
+        else if (kind == BATCH_RMDIR && info->content != NULL)
+            group[i]->status = STATUS_NOT_EMPTY;
+        else if (in_use(info, currentNode))
+            group[i]->status = STATUS_BUSY;
+
+        if (group[i]->status == STATUS_OK)
+            free_node(unlink_child(folder, prev, child, WATCH_DELETE));
+        else
+            prev = child;
     }
-    // if it was found and it is a directory it will be deleted
 
-    if (current_file->info->content != NULL) {
-        printf("rmdir: failed to remove '%s': Directory not empty\n",
-               folderName);
-        return;
+    for (int i = 0; i < count; i++) {
+        if (group[i]->first >= 0) {
+            int status = group[group[i]->first]->status;
+            group[i]->status = status == STATUS_OK ? STATUS_NO_ENTRY : status;
+        } else if (!group[i]->found) {
+            group[i]->status = STATUS_NO_ENTRY;
+        }
     }
+    name_set_free(&set);
+}
 
-    if (current_file == file_list->head) {
-        file_list->head = current_file->next;
-        free(current_file->info->name);
-        free(current_file->info);
-        free(current_file);
+static void run_group(TreeNode *currentNode, BatchTarget **group, int count,
+                      int kind, Blob *body) {
+    TreeNode *folder = currentNode;
+    if (group[0]->parent[0])
+        folder = walk_path(currentNode, group[0]->parent);
+
+    int status = STATUS_OK;
+    if (!folder)
+        status = STATUS_NO_ENTRY;
+    else if (folder->type != FOLDER_NODE)
+        status = STATUS_NOT_DIR;
+
+    if (status != STATUS_OK) {
+        for (int i = 0; i < count; i++)
+            group[i]->status = status;
+    } else if (kind == BATCH_MKDIR || kind == BATCH_TOUCH) {
+        create_group(folder, group, count, kind, body);
     } else {
-        prev_file->next = current_file->next;
-        free(current_file->info->name);
-        free(current_file->info);
-        free(current_file);
+        remove_group(currentNode, folder, group, count, kind);
     }
 }
 
 /*
-* This function creates a file that is added to the tail
-* of the currentNode's children list.
-*
-* It creates a TreeNode* that is a type of FILE_NODE, and its
-* void* content pointer is redirecting to FileContent.
+* Runs the operation for every target and writes the STATUS_* code of
+* each one in "statuses". "text" (of "size" bytes) is only used by
+* BATCH_TOUCH, and is added once to the store, then shared by every file.
 */
-void touch(TreeNode* currentNode, char* fileName, char* fileContent) {
-    ListNode *new_content_node;
+void batch_many(TreeNode *currentNode, const char *const *paths, int count,
+                int kind, const char *text, size_t size, int *statuses) {
+    BatchTarget *targets = malloc(count * sizeof(BatchTarget));
+    BatchTarget **sorted = malloc(count * sizeof(BatchTarget *));
+    Blob *body = NULL;
+    int simple = 1;
+
+    for (int i = 0; i < count; i++) {
+        simple &= split_target(&targets[i], paths[i]);
+        sorted[i] = &targets[i];
+    }
+    qsort(sorted, count, sizeof(BatchTarget *), compare_targets);
 
-    if (currentNode->content == NULL) {
-        FolderContent *directory_content = malloc(sizeof(FolderContent));
-        currentNode->content = directory_content;
+    if (kind == BATCH_TOUCH)
+        body = store_intern(text, size);
 
-        List *dir_content_head = malloc(sizeof(List));
-        directory_content->children = dir_content_head;
+    // the parents are checked once per group, before anything is changed
+    for (int i = 0; simple && i < count; i++) {
+        if (i == 0 || strcmp(sorted[i]->parent, sorted[i - 1]->parent))
+            simple = !parent_has_link(currentNode, sorted[i]->parent);
+    }
 
-        new_content_node = malloc(sizeof(ListNode));
-        dir_content_head->head = new_content_node;
+    if (simple && targets_independent(sorted, count)) {
+        for (int i = 0, j; i < count; i = j) {
+            for (j = i + 1; j < count; j++) {
+                if (strcmp(sorted[i]->parent, sorted[j]->parent))
+                    break;
+            }
+            run_group(currentNode, sorted + i, j - i, kind, body);
+        }
     } else {
-        FolderContent *directory_content =
-        (FolderContent *)currentNode->content;
-        ListNode *content_node = directory_content->children->head;
-        ListNode *prev;
-
-        while (content_node != NULL) {
-            if (!strcmp(content_node->info->name, fileName))
-                return;
-
-            prev = content_node;
-            content_node = content_node->next;
+        for (int i = 0; i < count; i++) {
+            sorted[0] = &targets[i];
+            run_group(currentNode, sorted, 1, kind, body);
         }
-
-        new_content_node = malloc(sizeof(ListNode));
-        prev->next = new_content_node;
     }
 
-    new_content_node->next = NULL;
-
-    TreeNode *info = malloc(sizeof(TreeNode));
-
-    info->parent = currentNode;
-    info->name = malloc(strlen(fileName) + 1);
-    memcpy(info->name, fileName, strlen(fileName) + 1);
-    info->type = FILE_NODE;
-
-    FileContent *file_node_content = malloc(sizeof(FileContent));
-    file_node_content->text = malloc(strlen(fileContent) + 1);
-    memcpy(file_node_content->text, fileContent, strlen(fileContent) + 1);
+    for (int i = 0; i < count; i++) {
+        statuses[i] = targets[i].status;
+        free(targets[i].full);
+        free(targets[i].parent);
+    }
 
-    info->content = file_node_content;
-    new_content_node->info = info;
+    if (body)
+        store_release(body);
+    free(targets);
+    free(sorted);
 }
 
 /*
-* This function is used to copy the effective data from the source node
-* to the destination node.
+* Runs the operation for a single target, without printing anything.
+* "text" (of "size" bytes) is only used by BATCH_TOUCH.
 *
-* One of the given parameters is represented by dest node, which is used
-* for linking nodes in the children list, as the source node may already
-* exist and it needs to be updated. There is also a need of determining the
-* parent of the new node, which is why there is dest used.
-*
-* There are 3 options that this function may get:
-* Option 1 -> dest represents the last node in the list of children
-*          -> it creates a new file at the end if there was not a file with
-*             the exact same name
-* Option 2 -> dest is ---- CURRENT - NODE ----
-*          -> in the given path, there is already a file with the same
-*          -> name, so its content just needs to be changed
-* Option 3 -> dest is ---- CURRENT - NODE ----
-*          -> if the destination directory is empty, it creates a new file
-*             and initializes it to be the head
-*/
-void copy_node(ListNode *dest, TreeNode *source, int option) {
-    TreeNode *current;
-
-    if (option == 1) {
-        dest->next = malloc(sizeof(ListNode));
-        dest->next->next = NULL;
-        dest->next->info = malloc(sizeof(TreeNode));
-        current = dest->next->info;
-        current->parent = dest->info->parent;
+* Returns the STATUS_* code that the command would report, or
+* STATUS_INVALID if the path has no name ("", "." or "/").
+*/
+int batch_one(TreeNode *currentNode, const char *path, int kind,
+              const char *text, size_t size) {
+    BatchTarget target, *group = &target;
+    Blob *body = NULL;
+
+    split_target(&target, path);
+    if (!target.name[0]) {
+        target.status = STATUS_INVALID;
     } else {
-        current = dest->info;
+        if (kind == BATCH_TOUCH)
+            body = store_intern(text, size);
+        run_group(currentNode, &group, 1, kind, body);
     }
+    free(target.full);
+    free(target.parent);
 
-    if (option == 1 || option == 3) {
-        current->name = malloc(strlen(source->name) + 1);
-        memcpy(current->name, source->name, strlen(source->name) + 1);
-    }
-    current->type = source->type;
+    if (body)
+        store_release(body);
+    return target.status;
+}
 
-    current->content = malloc(sizeof(FileContent));
-    FileContent *dest_file_cont = current->content;
+/*
+* This function gives the text of the source node to the destination
+* file. The text itself is not copied, as the store keeps it only once,
+* so the destination just releases its old text and shares the new one.
+*/
+static void copy_text(TreeNode *dest, TreeNode *source) {
+    FileContent *dest_file_cont = dest->content;
     FileContent *src_file_cont = source->content;
 
-    dest_file_cont->text = malloc(strlen(src_file_cont->text) + 1);
-    memcpy(dest_file_cont->text, src_file_cont->text,
-           strlen(src_file_cont->text) + 1);
-}
-
-// Freeing the copies of the source and destination paths
-static inline void free_copies(char *copy_source, char *copy_dest) {
-    free(copy_source);
-    free(copy_dest);
+    store_retain(src_file_cont->body);
+    if (!undo_text(dest, dest_file_cont->body))
+        store_release(dest_file_cont->body);
+    dest_file_cont->body = src_file_cont->body;
+    search_update(dest);
+    watch_publish(WATCH_MODIFY, dest, dest->parent);
 }
 
 /*
-* Function used to copy files from src to dest.
+* Copies the source file into dest_node.
 *
-* It is not copying the files through the concept of pointers,
-* but is copying raw data.
-*/
-void cp(TreeNode* currentNode, char* source, char* destination) {
-    char *copy_source = malloc(strlen(source) + 1);
-    char *copy_dest = malloc(strlen(destination) + 1);
-    memcpy(copy_source, source, strlen(source) + 1);
-    memcpy(copy_dest, destination, strlen(destination) + 1);
-
-    TreeNode *source_node = cd(currentNode, source, 3);
-    if (source_node->type == FOLDER_NODE) {
-        printf("cp: -r not specified; omitting directory '%s'", copy_source);
-        free_copies(copy_source, copy_dest);
-        return;
-    }
-
-    TreeNode *dest_node = cd(currentNode, destination, 2);
-    if (!dest_node) {
-        printf("cp: failed to access '%s': Not a directory", copy_dest);
-        free_copies(copy_source, copy_dest);
-        return;
-    }
-
+* If dest is a directory, the file is created at the end of its
+* children (or its text is replaced, if a file with the same name exists).
+* If dest is a file, its text is replaced.
+*
+* Returns STATUS_OK, or STATUS_IS_DIR if a directory would be
+* overwritten (or if a link with the same name points to nothing).
+*/
+int copy_into(TreeNode *source_node, TreeNode *dest_node) {
     if (dest_node->type == FOLDER_NODE) {
-        FolderContent *dir_content = dest_node->content;
-        if (!dir_content) {
-            dir_content = malloc(sizeof(FolderContent));
-            dir_content->children = malloc(sizeof(List));
-            dir_content->children->head = malloc(sizeof(ListNode));
-            dir_content->children->head->next = NULL;
-            dir_content->children->head->info = malloc(sizeof(TreeNode));
-            dir_content->children->head->info->type = FILE_NODE;
-            copy_node(dir_content->children->head, source_node, 3);
-            dest_node->content = dir_content;
-            free_copies(copy_source, copy_dest);
-            return;
-        }
-        ListNode *content_node = dir_content->children->head;
-
-        while (content_node->next) {
-            if (!strcmp(content_node->info->name, source_node->name)) {
-                FileContent *file_content = content_node->info->content;
-                free(file_content->text);
-                free(content_node->info->content);
-                free(content_node->info->name);
-                copy_node(content_node, source_node, 2);
-                free_copies(copy_source, copy_dest);
-                return;
-            }
-
-            content_node = content_node->next;
+        ListNode *existing = find_child(dest_node, source_node->name, NULL);
+        if (!existing) {
+            FileContent *src_file_cont = source_node->content;
+            store_retain(src_file_cont->body);
+            TreeNode *copy = new_node(source_node->name, FILE_NODE,
+                                      new_file_content(src_file_cont->body));
+            append_child(dest_node, copy);
+            search_add(copy);
+        } else {
+            // an existing link is written through, to the file it points to
+            TreeNode *target = resolve_link(existing->info);
+            if (!target || target->type == FOLDER_NODE)
+                return STATUS_IS_DIR;
+            if (target != source_node)
+                copy_text(target, source_node);
         }
-        copy_node(content_node, source_node, 1);
-    } else {
-        FileContent *file_content = dest_node->content;
-        free(file_content->text);
-        free(dest_node->content);
-        ListNode *tmp = malloc(sizeof(ListNode));
-        tmp->info = dest_node;
-        copy_node(tmp, source_node, 2);
-        free(tmp);
+    } else if (dest_node != source_node) {
+        copy_text(dest_node, source_node);
     }
-    free_copies(copy_source, copy_dest);
+    return STATUS_OK;
 }
 
 /*
-* Function that is used when moving a file into another file, so its
-* content needs to be updated.
+* Function that is used when moving a file into another file.
+* The source node takes the place and the name of the destination,
+* which is freed together with its content.
 */
 static inline void move_in_file(TreeNode* dest_node, TreeNode *source_node) {
     TreeNode *dest_parent = dest_node->parent;
     FolderContent *dest_content = dest_parent->content;
-    ListNode *dest_nodes = dest_content->children->head;
+    ListNode *dest_nodes = find_child(dest_parent, dest_node->name, NULL);
 
-    while (dest_nodes->next) {
-        if (!strcmp(dest_nodes->info->name, dest_node->name))
-            break;
-        dest_nodes = dest_nodes->next;
-    }
+    if (dest_content->index)
+        index_remove(dest_content->index, dest_node);
+    tree_changed();
+    watch_publish(WATCH_DELETE, dest_node, dest_parent);
 
-    FileContent *file_content = dest_node->content;
-    free(file_content->text);
-    free(dest_node->content);
-    free(source_node->name);
+    if (!undo_replace(dest_nodes, dest_node, source_node->name))
+        free(source_node->name);
     source_node->name = dest_node->name;
-    free(dest_node);
+    source_node->parent = dest_parent;
     dest_nodes->info = source_node;
+
+    if (dest_content->index)
+        index_insert(dest_content->index, source_node);
+    watch_publish(WATCH_MOVED_TO, source_node, dest_parent);
+
+    dest_node->name = NULL;
+    free_node(dest_node);
 }
 
 /*
-* If the *cp* function is copying raw data, this *mv* function
-* is just working with pointers, as the node that needs to be
-* removed from a directory is going to change its parent to
-* the destination.
+* Moves the source node into dest_node, by changing its parent.
+* Nothing is moved if dest_node is the source itself or one of its
+* subdirectories (STATUS_INVALID), or if dest_node already has a
+* directory with the same name (STATUS_NOT_EMPTY).
 */
-void mv(TreeNode* currentNode, char* source, char* destination) {
-    char *copy_source = malloc(strlen(source) + 1);
-    char *copy_dest = malloc(strlen(destination) + 1);
-    memcpy(copy_source, source, strlen(source) + 1);
-    memcpy(copy_dest, destination, strlen(destination) + 1);
-
-    TreeNode *source_node = cd(currentNode, source, 2);
-    TreeNode *dest_node = cd(currentNode, destination, 2);
-
-    if (!source_node) {
-        printf("mv: failed to access '%s': Not a directory", copy_source);
-        free_copies(copy_source, copy_dest);
-        return;
-    }
-
-    if (!dest_node) {
-        printf("mv: failed to access '%s': Not a directory", copy_dest);
-        free_copies(copy_source, copy_dest);
-        return;
+int move_into(TreeNode *source_node, TreeNode *dest_node) {
+    for (TreeNode *node = dest_node; node; node = node->parent) {
+        if (node == source_node)
+            return source_node->type == FILE_NODE ? STATUS_OK
+                                                  : STATUS_INVALID;
     }
 
     TreeNode *source_parent = source_node->parent;
-
     FolderContent *parent_content = source_parent->content;
     ListNode *children = parent_content->children->head, *prev = NULL;
 
-    while (children) {
-        if (!strcmp(copy_source + strlen(copy_source) -
-            strlen(children->info->name), children->info->name))
-            break;
+    while (children->info != source_node) {
         prev = children;
         children = children->next;
     }
+    // a file with the same name in the destination folder is replaced
+    if (dest_node->type == FOLDER_NODE) {
+        ListNode *existing = find_child(dest_node, source_node->name, NULL);
+        if (existing && existing->info == source_node)
+            return STATUS_OK;
+        if (existing && existing->info->type == FOLDER_NODE)
+            return STATUS_NOT_EMPTY;
+        if (existing)
+            dest_node = existing->info;
+    }
+    unlink_child(source_parent, prev, children, WATCH_MOVED_FROM);
 
-    if (prev == NULL) {
-        parent_content->children->head = children->next;
+    if (dest_node->type != FOLDER_NODE) {
+        // FILE CASE (a link with the same name is replaced as well)
+        move_in_file(dest_node, source_node);
     } else {
-        prev->next = children->next;
+        // DIRECTORY CASE
+        append_child(dest_node, source_node);
     }
+    return STATUS_OK;
+}
 
-    children->next = NULL;
+// The link becomes one more name of the content of "target"
+static void add_hard_link(FileContent *file_content, TreeNode *target,
+                          TreeNode *link) {
+    if (!file_content->nodes) {
+        file_content->nodes = malloc(2 * sizeof(TreeNode *));
+        file_content->nodes[0] = target;
+    } else {
+        file_content->nodes = realloc(file_content->nodes,
+                                      (file_content->links + 1) *
+                                      sizeof(TreeNode *));
+    }
+    file_content->nodes[file_content->links++] = link;
+}
 
-    // FILE CASE
-    if (dest_node->type == FILE_NODE) {
-        move_in_file(dest_node, source_node);
-        free(children);
-        free_copies(copy_source, copy_dest);
-        return;
+/*
+* Creates a link, named after the last component of "linkName".
+*
+* A hard link is a new file node that shares the FileContent of the
+* target, so every name sees the same text and the content is freed
+* only with its last link. A symbolic link just keeps the path of its
+* target (relative to the folder of the link), which may not exist yet.
+*/
+int link_path(TreeNode *currentNode, const char *target,
+              const char *linkName, int symbolic) {
+    TreeNode *target_node = NULL;
+
+    if (strlen(target) == 0 || strlen(linkName) == 0)
+        return STATUS_INVALID;
+
+    if (!symbolic) {
+        target_node = walk_path(currentNode, target);
+        if (!target_node)
+            return STATUS_NO_TARGET;
+        if (target_node->type == FOLDER_NODE)
+            return STATUS_IS_DIR;
     }
 
-    // DIRECTORY CASE
-    FolderContent *dest_content = dest_node->content;
-    if (!dest_content) {
-        dest_content = malloc(sizeof(FolderContent));
-        dest_content->children = malloc(sizeof(List));
-        dest_content->children->head = children;
-        dest_node->content = dest_content;
-        free_copies(copy_source, copy_dest);
-        return;
+    TreeNode *folder = currentNode;
+    const char *name = strrchr(linkName, '/');
+    if (name) {
+        size_t folder_len = name - linkName;
+        char *folder_path = malloc(folder_len + 1);
+        memcpy(folder_path, linkName, folder_len);
+        folder_path[folder_len] = '\0';
+        folder = walk_path(currentNode, folder_path);
+        free(folder_path);
+        name++;
+    } else {
+        name = linkName;
+    }
+
+    if (!folder || folder->type != FOLDER_NODE || strlen(name) == 0)
+        return STATUS_NO_ENTRY;
+    if (find_child(folder, name, NULL))
+        return STATUS_EXISTS;
+
+    TreeNode *link;
+    if (symbolic) {
+        link = new_node(name, SYMLINK_NODE, new_link_content(target));
+    } else {
+        FileContent *file_content = (FileContent *)target_node->content;
+        link = new_node(name, FILE_NODE, file_content);
+        add_hard_link(file_content, target_node, link);
+    }
+    append_child(folder, link);
+    search_add(link);
+    return STATUS_OK;
+}
+
+/*
+* Splits a glob argument ("dir/sub/log_*") into the folder that has to be
+* searched and the compiled pattern of its last component. Only the last
+* component may contain wildcards.
+*
+* Returns NULL if the folder does not exist.
+*/
+static TreeNode *glob_folder(TreeNode *currentNode, const char *arg,
+                             Pattern **pattern) {
+    const char *slash = strrchr(arg, '/');
+    TreeNode *folder = currentNode;
+
+    if (slash) {
+        size_t dir_len = slash - arg + 1;
+        char *dir = malloc(dir_len + 1);
+        memcpy(dir, arg, dir_len);
+        dir[dir_len] = '\0';
+        folder = walk_path(currentNode, dir);
+        free(dir);
     }
 
-    ListNode *dest_nodes = dest_content->children->head;
+    if (!folder || folder->type != FOLDER_NODE)
+        return NULL;
 
-    while (dest_nodes->next)
-        dest_nodes = dest_nodes->next;
+    *pattern = pattern_compile(slash ? slash + 1 : arg);
+    return folder;
+}
 
-    dest_nodes->next = children;
-    free_copies(copy_source, copy_dest);
+/*
+* Collects the children that match the pattern, in a single pass over
+* the folder's list. The nodes are stored in the order of the list; the
+* result is NULL if nothing matched, and "count" is -1 if the folder
+* does not exist.
+*/
+TreeNode **glob_collect(TreeNode *currentNode, const char *arg, int *count) {
+    TreeNode **matches = NULL;
+    Pattern *pattern;
+    int size = 0;
+    *count = -1;
+
+    TreeNode *folder = glob_folder(currentNode, arg, &pattern);
+    if (!folder)
+        return NULL;
+    *count = 0;
+
+    FolderContent *directory_content = (FolderContent *)folder->content;
+    ListNode *content_node = NULL;
+    if (directory_content)
+        content_node = directory_content->children->head;
+
+    for (; content_node; content_node = content_node->next) {
+        if (!pattern_match(pattern, content_node->info->name))
+            continue;
+
+        if (*count == size) {
+            size = size ? 2 * size : 16;
+            matches = realloc(matches, size * sizeof(TreeNode *));
+        }
+        matches[(*count)++] = content_node->info;
+    }
+    pattern_free(pattern);
+    return matches;
 }
 
+/*
+* Removes the children that match the pattern, unlinking them during
+* the same pass over the list. Without "recursive", directories are
+* reported and kept, just like *rm* does. Every match is given to
+* "result" with its status, before it is freed.
+*
+* Returns STATUS_NO_ENTRY if nothing matched.
+*/
+int remove_matching(TreeNode *currentNode, const char *arg, int recursive,
+                    RemoveResult result, void *resultArg) {
+    Pattern *pattern;
+    int matched = 0;
+
+    TreeNode *folder = glob_folder(currentNode, arg, &pattern);
+    if (!folder)
+        return STATUS_NO_ENTRY;
+
+    ListNode *prev = NULL, *child = NULL, *next;
+    if (folder->content)
+        child = ((FolderContent *)folder->content)->children->head;
+
+    while (child) {
+        next = child->next;
+        if (!pattern_match(pattern, child->info->name)) {
+            prev = child;
+            child = next;
+            continue;
+        }
 
+        int status = STATUS_OK;
+        if (!recursive && child->info->type == FOLDER_NODE)
+            status = STATUS_IS_DIR;
+        else if (in_use(child->info, currentNode))
+            status = STATUS_BUSY;
+
+        matched++;
+        result(child->info->name, status, resultArg);
+        if (status == STATUS_OK)
+            free_node(unlink_child(folder, prev, child, WATCH_DELETE));
+        else
+            prev = child;
+        child = next;
+    }
+    pattern_free(pattern);
+
+    return matched ? STATUS_OK : STATUS_NO_ENTRY;
+}
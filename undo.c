@@ -0,0 +1,231 @@
+// Copyright Avram Cristian - Stefan 2022 stefanavram93@gmail.com
+// Copyright Dumitrescu Rares - Matei 2022 mateidum828@gmail.com
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "tree.h"
+#include "index.h"
+#include "search.h"
+#include "undo.h"
+#include "watch.h"
+
+#define UNDO_LINK 0     // a child was added to "node" after "extra"
+#define UNDO_CREATE 1   // the same, but the child was created by the command
+#define UNDO_UNLINK 2   // a child was taken out of "node", from after "extra"
+#define UNDO_FREE 3     // "node" would have been freed
+#define UNDO_TEXT 4     // the text of "node" was "extra"
+#define UNDO_REPLACE 5  // "node" was in "slot"; the new node was "extra"
+
+typedef struct UndoRecord UndoRecord;
+
+/*
+* A record keeps just what is needed to reverse one change of the tree.
+* The list nodes and the tree nodes taken out of the tree are kept by
+* the records, so every step of *abort* links them back directly.
+*/
+struct UndoRecord {
+    int type;
+    TreeNode* node;
+    ListNode* slot;
+    void* extra;
+};
+
+static struct {
+    int active;
+    UndoRecord* records;
+    size_t size, capacity;
+} undo_log;
+
+static void add_record(int type, TreeNode *node, ListNode *slot,
+                       void *extra) {
+    if (undo_log.size == undo_log.capacity) {
+        undo_log.capacity = undo_log.capacity ? 2 * undo_log.capacity : 64;
+        undo_log.records = realloc(undo_log.records,
+                                   undo_log.capacity * sizeof(UndoRecord));
+    }
+    UndoRecord *record = &undo_log.records[undo_log.size++];
+    record->type = type;
+    record->node = node;
+    record->slot = slot;
+    record->extra = extra;
+}
+
+int undo_active(void) {
+    return undo_log.active;
+}
+
+// Starts recording; returns 0 if a transaction is already in progress
+int undo_begin(void) {
+    if (undo_log.active)
+        return 0;
+    undo_log.active = 1;
+    return 1;
+}
+
+void undo_link(TreeNode *folder, ListNode *prev, ListNode *child,
+               int created) {
+    if (undo_log.active)
+        add_record(created ? UNDO_CREATE : UNDO_LINK, folder, child, prev);
+}
+
+int undo_unlink(TreeNode *folder, ListNode *prev, ListNode *child) {
+    if (undo_log.active)
+        add_record(UNDO_UNLINK, folder, child, prev);
+    return undo_log.active;
+}
+
+/*
+* A removed subtree is kept whole, so *abort* only has to link it back.
+* Its files are taken out of the search index until then.
+*/
+int undo_free(TreeNode *node) {
+    if (undo_log.active) {
+        add_record(UNDO_FREE, node, NULL, NULL);
+        search_remove(node);
+    }
+    return undo_log.active;
+}
+
+int undo_text(TreeNode *file, Blob *old_body) {
+    if (undo_log.active)
+        add_record(UNDO_TEXT, file, NULL, old_body);
+    return undo_log.active;
+}
+
+// "old_name" is the name of the node that now takes the slot
+int undo_replace(ListNode *slot, TreeNode *old_node, char *old_name) {
+    if (undo_log.active)
+        add_record(UNDO_REPLACE, old_node, slot, old_name);
+    return undo_log.active;
+}
+
+// Puts back the node that was replaced by a moved file
+static void undo_replaced(UndoRecord *record) {
+    TreeNode *old_node = record->node, *new_node = record->slot->info;
+    FolderContent *directory_content = old_node->parent->content;
+
+    if (directory_content->index)
+        index_remove(directory_content->index, new_node);
+    tree_changed();
+    watch_publish(WATCH_DELETE, new_node, old_node->parent);
+
+    old_node->name = new_node->name;
+    new_node->name = record->extra;
+    record->slot->info = old_node;
+
+    if (directory_content->index)
+        index_insert(directory_content->index, old_node);
+    watch_publish(WATCH_CREATE, old_node, old_node->parent);
+}
+
+static int compare_nodes(const void *a, const void *b) {
+    uintptr_t first = (uintptr_t)*(TreeNode *const *)a;
+    uintptr_t second = (uintptr_t)*(TreeNode *const *)b;
+    return (first > second) - (first < second);
+}
+
+/*
+* Returns the current folder, or its closest ancestor that is not one
+* of the given nodes (or inside them), as these are going to be freed.
+* The nodes are sorted once, so every ancestor is found by a binary
+* search instead of a pass over all of them.
+*/
+static TreeNode *surviving_folder(TreeNode *currentNode, TreeNode **freed,
+                                  size_t count) {
+    TreeNode *result = currentNode;
+
+    qsort(freed, count, sizeof(TreeNode *), compare_nodes);
+    for (TreeNode *node = currentNode; node && count; node = node->parent) {
+        if (bsearch(&node, freed, count, sizeof(TreeNode *), compare_nodes))
+            result = node->parent;
+    }
+    return result;
+}
+
+/*
+* Reverses the records, from the last one to the first one, so every
+* step finds the tree exactly as the change left it. The nodes created
+* during the transaction are freed at the end.
+*/
+TreeNode *undo_rollback(TreeNode *currentNode, size_t *nr_of_records) {
+    TreeNode **created = malloc((undo_log.size + 1) * sizeof(TreeNode *));
+    size_t nr_of_created = 0;
+    undo_log.active = 0;
+
+    for (size_t i = undo_log.size; i-- > 0;) {
+        UndoRecord *record = &undo_log.records[i];
+        FileContent *file_content;
+
+        switch (record->type) {
+        case UNDO_LINK:
+        case UNDO_CREATE:
+            watch_publish(WATCH_DELETE, record->slot->info, record->node);
+            detach_child(record->node, record->extra, record->slot);
+            if (record->type == UNDO_CREATE)
+                created[nr_of_created++] = record->slot->info;
+            free(record->slot);
+            break;
+        case UNDO_UNLINK:
+            link_child(record->node, record->extra, record->slot);
+            watch_publish(WATCH_CREATE, record->slot->info, record->node);
+            break;
+        case UNDO_FREE:
+            search_add(record->node);
+            break;
+        case UNDO_TEXT:
+            file_content = record->node->content;
+            store_release(file_content->body);
+            file_content->body = record->extra;
+            search_update(record->node);
+            watch_publish(WATCH_MODIFY, record->node, record->node->parent);
+            break;
+        case UNDO_REPLACE:
+            undo_replaced(record);
+            break;
+        }
+    }
+
+    currentNode = surviving_folder(currentNode, created, nr_of_created);
+    for (size_t i = 0; i < nr_of_created; i++)
+        free_node(created[i]);
+    free(created);
+
+    if (nr_of_records)
+        *nr_of_records = undo_log.size;
+    undo_log.size = 0;
+    return currentNode;
+}
+
+/*
+* Makes the changes final: the kept nodes, list nodes, texts and names
+* are freed now.
+*/
+TreeNode *undo_commit(TreeNode *currentNode, size_t *nr_of_records) {
+    TreeNode **freed = malloc((undo_log.size + 1) * sizeof(TreeNode *));
+    size_t nr_of_freed = 0;
+    undo_log.active = 0;
+
+    for (size_t i = 0; i < undo_log.size; i++) {
+        if (undo_log.records[i].type == UNDO_FREE)
+            freed[nr_of_freed++] = undo_log.records[i].node;
+    }
+    currentNode = surviving_folder(currentNode, freed, nr_of_freed);
+
+    for (size_t i = 0; i < undo_log.size; i++) {
+        UndoRecord *record = &undo_log.records[i];
+
+        if (record->type == UNDO_UNLINK)
+            free(record->slot);
+        else if (record->type == UNDO_FREE)
+            free_node(record->node);
+        else if (record->type == UNDO_TEXT)
+            store_release(record->extra);
+        else if (record->type == UNDO_REPLACE)
+            free(record->extra);
+    }
+    free(freed);
+
+    *nr_of_records = undo_log.size;
+    undo_log.size = 0;
+    return currentNode;
+}
@@ -0,0 +1,23 @@
+#ifndef UNDO_H
+#define UNDO_H
+
+#include "node.h"
+
+/*
+* Outside of a transaction, these functions record nothing and return 0,
+* so the caller frees what it has to. During a transaction, they return 1
+* and the undo log keeps the given data until *commit* or *abort*.
+*/
+void undo_link(TreeNode* folder, ListNode* prev, ListNode* child,
+               int created);
+int undo_unlink(TreeNode* folder, ListNode* prev, ListNode* child);
+int undo_free(TreeNode* node);
+int undo_text(TreeNode* file, Blob* old_body);
+int undo_replace(ListNode* slot, TreeNode* old_node, char* old_name);
+
+int undo_active(void);
+int undo_begin(void);
+TreeNode* undo_commit(TreeNode* currentNode, size_t* nr_of_records);
+TreeNode* undo_rollback(TreeNode* currentNode, size_t* nr_of_records);
+
+#endif  // UNDO_H
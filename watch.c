@@ -0,0 +1,84 @@
+// Copyright Avram Cristian - Stefan 2022 stefanavram93@gmail.com
+// Copyright Dumitrescu Rares - Matei 2022 mateidum828@gmail.com
+
+#include <stdlib.h>
+#include <string.h>
+#include "watch.h"
+
+#define WATCH_MASK (WATCH_RING_SIZE - 1)
+
+/*
+* A single producer ring of events. The event with the number "n" is kept
+* in slot n % WATCH_RING_SIZE, whose "seq" is 2n + 1 while it is written
+* and 2n + 2 when it is complete. A consumer copies the event and checks
+* "seq" again (as a seqlock): if the producer wrote the slot meanwhile,
+* the consumer fell behind by a whole ring, and the events that were
+* overwritten are counted as lost.
+*/
+static WatchEvent ring[WATCH_RING_SIZE];
+static uint64_t ring_head;  // the number of the next event
+static int nr_of_consumers;
+
+void watch_publish(int type, TreeNode *node, TreeNode *parent) {
+    if (!__atomic_load_n(&nr_of_consumers, __ATOMIC_RELAXED))
+        return;
+
+    uint64_t seq = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+    WatchEvent *slot = &ring[seq & WATCH_MASK];
+
+    __atomic_store_n(&slot->seq, 2 * seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->type = type;
+    slot->node_id = node->id;
+    slot->parent_id = parent ? parent->id : 0;
+    strncpy(slot->name, node->name ? node->name : "", WATCH_NAME_LEN - 1);
+    slot->name[WATCH_NAME_LEN - 1] = '\0';
+    __atomic_store_n(&slot->seq, 2 * seq + 2, __ATOMIC_RELEASE);
+
+    __atomic_store_n(&ring_head, seq + 1, __ATOMIC_RELEASE);
+}
+
+// Returns the cursor of a new consumer, which sees the events from now on
+uint64_t watch_subscribe(void) {
+    __atomic_add_fetch(&nr_of_consumers, 1, __ATOMIC_RELAXED);
+    return __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+}
+
+void watch_unsubscribe(void) {
+    __atomic_sub_fetch(&nr_of_consumers, 1, __ATOMIC_RELAXED);
+}
+
+/*
+* Copies up to "max" of the events after the cursor and moves the cursor
+* after them. The events that were overwritten before they could be read
+* are skipped and added to "lost". Never blocks the producer.
+*/
+size_t watch_read(uint64_t *cursor, WatchEvent *events, size_t max,
+                  uint64_t *lost) {
+    size_t count = 0;
+    uint64_t head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+
+    while (count < max && *cursor < head) {
+        if (head - *cursor > WATCH_RING_SIZE) {
+            *lost += head - WATCH_RING_SIZE - *cursor;
+            *cursor = head - WATCH_RING_SIZE;
+        }
+
+        WatchEvent *slot = &ring[*cursor & WATCH_MASK];
+        uint64_t before = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (before == 2 * *cursor + 2) {
+            memcpy(&events[count], slot, sizeof(WatchEvent));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == before) {
+                events[count++].seq = *cursor;
+                (*cursor)++;
+                continue;
+            }
+        }
+        // the slot was written again, the producer is a ring ahead
+        (*lost)++;
+        (*cursor)++;
+        head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+    }
+    return count;
+}
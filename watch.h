@@ -0,0 +1,40 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stdint.h>
+#include "node.h"
+
+#define WATCH_RING_SIZE 4096  // a power of 2
+#define WATCH_NAME_LEN 44
+
+typedef struct WatchEvent WatchEvent;
+
+enum WatchEventType {
+    WATCH_CREATE,
+    WATCH_DELETE,
+    WATCH_MODIFY,
+    WATCH_MOVED_FROM,
+    WATCH_MOVED_TO
+};
+
+// 64 bytes, so a slot of the ring is one cache line
+struct WatchEvent {
+    uint64_t seq;
+    uint32_t type;
+    uint32_t node_id;
+    uint32_t parent_id;
+    char name[WATCH_NAME_LEN];  // cut if it is longer
+};
+
+/*
+* The events are published by the thread that changes the tree, and are
+* read by any number of consumers, each with its own cursor, without
+* locks. Nothing is published while there are no consumers.
+*/
+void watch_publish(int type, TreeNode* node, TreeNode* parent);
+uint64_t watch_subscribe(void);
+void watch_unsubscribe(void);
+size_t watch_read(uint64_t* cursor, WatchEvent* events, size_t max,
+                  uint64_t* lost);
+
+#endif  // WATCH_H